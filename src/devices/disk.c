@@ -1,12 +1,15 @@
 #include "devices/disk.h"
 #include <ctype.h>
 #include <debug.h>
+#include <list.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -32,6 +35,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +51,53 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Bus master IDE registers, relative to a channel's bm_base.
+   See [IDE-BM]. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRDT address. */
+
+/* Bus master command register bits. */
+#define BM_START 0x01           /* Start/stop bus master. */
+#define BM_READ 0x08            /* 1=device to memory, 0=memory to device. */
+
+/* Bus master status register bits. */
+#define BM_ACTIVE 0x01          /* Transfer in progress. */
+#define BM_ERROR 0x02           /* Transfer failed (write 1 to clear). */
+#define BM_IRQ 0x04             /* Device interrupted (write 1 to clear). */
+
+/* A physical region descriptor, one entry in the table that
+   tells the bus master where in memory to transfer data.  A
+   region may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Byte count, 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
+#define PRD_BOUNDARY 0x10000    /* Regions may not cross this. */
+
+/* Most sectors a single command can transfer.  The sector count
+   register is 8 bits wide, with 0 meaning 256. */
+#define MAX_SECTORS 256
+
+/* Request scheduling.
+   Pending requests on a channel are served in C-LOOK order:
+   ascending sector order from the current head position,
+   wrapping around to the lowest pending sector.  A request that
+   has waited longer than its expiry time is served next
+   regardless of position, which bounds per-request latency.
+   Reads expire sooner than writes because a reader is usually
+   blocked on the data, e.g. in a page fault. */
+#define READ_EXPIRE 10                  /* Read deadline, in ticks. */
+#define WRITE_EXPIRE 50                 /* Write deadline, in ticks. */
 
 /* An ATA device. */
 struct disk 
@@ -57,6 +108,9 @@ struct disk
 
     bool is_ata;                /* 1=This device is an ATA disk. */
     disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+    int multiple;               /* Sectors per READ/WRITE MULTIPLE block,
+                                   or 0 if those commands are unusable. */
+    bool dma;                   /* True to transfer by bus-master DMA. */
 
     long long read_cnt;         /* Number of sectors read. */
     long long write_cnt;        /* Number of sectors written. */
@@ -69,11 +123,29 @@ struct channel
     char name[8];               /* Name, e.g. "hd0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
+    uint16_t bm_base;           /* Bus master base I/O port, or 0 if the
+                                   controller cannot do DMA. */
+    struct prd *prdt;           /* Physical region descriptor table. */
+
+    /* Request queue.
+       Shared with the interrupt handler, so protected by
+       disabling interrupts. */
+    struct list queue;          /* Pending requests, in position order. */
+    struct list batch;          /* Requests in the command in progress. */
+    uint32_t head;              /* Position just past the last command. */
+
+    /* Progress of the command in progress. */
+    size_t xfer_cnt;            /* Sectors in the command. */
+    size_t xfer_done;           /* Sectors transferred so far. */
+    struct disk_request *xfer_req;      /* Request owning next sector. */
+    size_t xfer_ofs;            /* Index of next sector in xfer_req. */
+    bool xfer_dma;              /* True if the command uses DMA. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
-    struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    struct semaphore completion_wait;   /* Up'd by interrupt handler for
+                                           commands issued outside the
+                                           request queue. */
 
     struct disk devices[2];     /* The devices on this channel. */
   };
@@ -86,22 +158,35 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void set_multiple_mode (struct disk *, int);
+static uint16_t find_bus_master (void);
+static void setup_prdt (struct channel *);
+
+static void select_sector (struct disk *, disk_sector_t, size_t sec_cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
+static bool poll_while_busy (const struct disk *);
 static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
 static void interrupt_handler (struct intr_frame *);
 
+static list_less_func request_less;
+static void start_command (struct channel *);
+static void merge_requests (struct channel *, struct disk_request *);
+static void transfer_block (struct channel *);
+static void service_interrupt (struct channel *);
+static void finish_command (struct channel *);
+
 /* Initialize the disk subsystem and detect disks. */
 void
 disk_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -124,7 +209,11 @@ disk_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
+      c->prdt = c->bm_base != 0 ? palloc_get_page (PAL_ASSERT) : NULL;
+      list_init (&c->queue);
+      list_init (&c->batch);
+      c->head = 0;
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -138,6 +227,8 @@ disk_init (void)
 
           d->is_ata = false;
           d->capacity = 0;
+          d->multiple = 0;
+          d->dma = false;
 
           d->read_cnt = d->write_cnt = 0;
         }
@@ -173,8 +264,9 @@ disk_print_stats (void)
         {
           struct disk *d = disk_get (chan_no, dev_no);
           if (d != NULL && d->is_ata) 
-            printf ("%s: %lld reads, %lld writes\n",
-                    d->name, d->read_cnt, d->write_cnt);
+            printf ("%s: %lld reads, %lld writes (%s)\n",
+                    d->name, d->read_cnt, d->write_cnt,
+                    d->dma ? "DMA" : "PIO");
         }
     }
 }
@@ -219,22 +311,7 @@ disk_size (struct disk *d)
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) 
 {
-  struct channel *c;
-  
-  ASSERT (d != NULL);
-  ASSERT (buffer != NULL);
-  // printf("sector number : %x\n", sec_no);
-
-  c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  d->read_cnt++;
-  lock_release (&c->lock);
+  disk_read_multiple (d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -245,24 +322,401 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
-  struct channel *c;
-  
+  disk_write_multiple (d, sec_no, buffer, 1);
+}
+
+/* Reads SEC_CNT consecutive sectors starting at SEC_NO from disk
+   D into BUFFER, which must have room for SEC_CNT *
+   DISK_SECTOR_SIZE bytes.  Requests of up to 256 sectors are
+   transferred with a single command.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *buffer,
+                    size_t sec_cnt) 
+{
+  struct disk_request r;
+
+  disk_request_init (&r, d, sec_no, buffer, sec_cnt, false, NULL, NULL);
+  disk_submit (&r);
+  disk_wait (&r);
+}
+
+/* Writes SEC_CNT consecutive sectors starting at SEC_NO to disk
+   D from BUFFER, which must contain SEC_CNT * DISK_SECTOR_SIZE
+   bytes.  Returns after the disk has acknowledged receiving the
+   data.  Requests of up to 256 sectors are transferred with a
+   single command.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no,
+                     const void *buffer, size_t sec_cnt) 
+{
+  struct disk_request r;
+
+  /* The buffer is only read from, but requests share one
+     layout for both directions. */
+  disk_request_init (&r, d, sec_no, (void *) buffer, sec_cnt, true,
+                     NULL, NULL);
+  disk_submit (&r);
+  disk_wait (&r);
+}
+
+/* Initializes R as a request to read or write (according to
+   WRITE) SEC_CNT sectors starting at SEC_NO on disk D, to or
+   from BUFFER.  SEC_CNT must be between 1 and 256.
+
+   When the request completes, CALLBACK (if nonnull) is called
+   with R and AUX from the disk interrupt handler, so it must not
+   sleep, and then R's done semaphore is raised. */
+void
+disk_request_init (struct disk_request *r, struct disk *d,
+                   disk_sector_t sec_no, void *buffer, size_t sec_cnt,
+                   bool write, disk_callback_func *callback, void *aux) 
+{
+  ASSERT (r != NULL);
   ASSERT (d != NULL);
   ASSERT (buffer != NULL);
+  ASSERT (sec_cnt > 0 && sec_cnt <= MAX_SECTORS);
+
+  r->disk = d;
+  r->sec_no = sec_no;
+  r->sec_cnt = sec_cnt;
+  r->buffer = buffer;
+  r->write = write;
+  r->deadline = 0;
+  r->callback = callback;
+  r->aux = aux;
+  sema_init (&r->done, 0);
+}
 
+/* Queues request R and returns without waiting for it.  R and
+   its buffer must remain valid until it completes.  Use
+   disk_wait() or R's callback to learn of completion.
+   May be called with interrupts disabled. */
+void
+disk_submit (struct disk_request *r) 
+{
+  struct channel *c = r->disk->channel;
+  enum intr_level old_level;
 
-  c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  d->write_cnt++;
-  lock_release (&c->lock);
+  ASSERT (r->sec_no < r->disk->capacity);
+  ASSERT (r->sec_cnt <= r->disk->capacity - r->sec_no);
+
+  r->deadline = timer_ticks () + (r->write ? WRITE_EXPIRE : READ_EXPIRE);
+
+  old_level = intr_disable ();
+  list_insert_ordered (&c->queue, &r->elem, request_less, NULL);
+  start_command (c);
+  intr_set_level (old_level);
+}
+
+/* Waits for submitted request R to complete.  At most one thread
+   may wait for a given request. */
+void
+disk_wait (struct disk_request *r) 
+{
+  sema_down (&r->done);
 }
 
+/* Request scheduling.
+
+   Requests are served by the channel's interrupt handler: each
+   completion interrupt moves the next block of data and, at the
+   end of a command, completes its requests and issues the
+   command for the next queued request.  Nothing holds the
+   channel while waiting for the device, so any number of
+   requests may be outstanding. */
+
+/* Returns the position of request R on its channel.  Sectors
+   are limited to 28 bits, so the device number is folded in
+   above them to give a single ordering over both devices. */
+static uint32_t
+request_position (const struct disk_request *r) 
+{
+  return ((uint32_t) r->disk->dev_no << 28) | r->sec_no;
+}
+
+/* Returns true if request A precedes request B in position
+   order. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED) 
+{
+  const struct disk_request *a = list_entry (a_, struct disk_request, elem);
+  const struct disk_request *b = list_entry (b_, struct disk_request, elem);
+
+  return request_position (a) < request_position (b);
+}
+
+/* Chooses the next request to serve on channel C, which must
+   have a nonempty queue.  An expired request wins; otherwise
+   the first request at or past the head in C-LOOK order. */
+static struct disk_request *
+pick_request (struct channel *c) 
+{
+  struct disk_request *oldest = NULL;
+  struct disk_request *next = NULL;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!list_empty (&c->queue));
+
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e)) 
+    {
+      struct disk_request *r = list_entry (e, struct disk_request, elem);
+      if (oldest == NULL || r->deadline < oldest->deadline)
+        oldest = r;
+      if (next == NULL && request_position (r) >= c->head)
+        next = r;
+    }
+
+  if (timer_ticks () >= oldest->deadline)
+    return oldest;
+  if (next == NULL)
+    next = list_entry (list_front (&c->queue), struct disk_request, elem);
+  return next;
+}
+
+/* If channel C is idle and has queued requests, issues the
+   command for the next one, merged with any queued requests
+   that continue it.  Interrupts must be off. */
+static void
+start_command (struct channel *c) 
+{
+  struct disk_request *r;
+  struct disk *d;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!list_empty (&c->batch) || list_empty (&c->queue))
+    return;
+
+  r = pick_request (c);
+  d = r->disk;
+  list_remove (&r->elem);
+  list_push_back (&c->batch, &r->elem);
+  merge_requests (c, r);
+
+  c->xfer_cnt = 0;
+  for (e = list_begin (&c->batch); e != list_end (&c->batch);
+       e = list_next (e))
+    c->xfer_cnt += list_entry (e, struct disk_request, elem)->sec_cnt;
+  c->xfer_done = 0;
+  c->xfer_req = r;
+  c->xfer_ofs = 0;
+  c->xfer_dma = d->dma;
+
+  if (c->xfer_dma) 
+    {
+      /* Point the bus master at the batch's buffers, clear stale
+         status, and start it once the command is issued.  The
+         whole transfer then completes with one interrupt. */
+      setup_prdt (c);
+      outl (reg_bm_prdt (c), vtop (c->prdt));
+      outb (reg_bm_command (c), r->write ? 0 : BM_READ);
+      outb (reg_bm_status (c), BM_ERROR | BM_IRQ);
+      select_sector (d, r->sec_no, c->xfer_cnt);
+      c->expecting_interrupt = true;
+      outb (reg_command (c), r->write ? CMD_WRITE_DMA : CMD_READ_DMA);
+      outb (reg_bm_command (c), (r->write ? 0 : BM_READ) | BM_START);
+      return;
+    }
+
+  select_sector (d, r->sec_no, c->xfer_cnt);
+  c->expecting_interrupt = true;
+  if (r->write)
+    {
+      outb (reg_command (c), d->multiple > 0
+            ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY);
+
+      /* The first block is sent without waiting for an
+         interrupt; each later one follows an interrupt. */
+      if (!poll_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, r->sec_no);
+      transfer_block (c);
+    }
+  else
+    outb (reg_command (c), d->multiple > 0
+          ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY);
+}
+
+/* Moves queued requests that continue request R on disk, in the
+   same direction, from channel C's queue to the end of its
+   batch, as long as the combined transfer fits in one
+   command. */
+static void
+merge_requests (struct channel *c, struct disk_request *r) 
+{
+  disk_sector_t end = r->sec_no + r->sec_cnt;
+  size_t sec_cnt = r->sec_cnt;
+  struct list_elem *e;
+
+  for (e = list_begin (&c->queue); e != list_end (&c->queue); )
+    {
+      struct disk_request *q = list_entry (e, struct disk_request, elem);
+      e = list_next (e);
+      if (q->disk == r->disk && q->write == r->write && q->sec_no == end
+          && sec_cnt + q->sec_cnt <= MAX_SECTORS) 
+        {
+          list_remove (&q->elem);
+          list_push_back (&c->batch, &q->elem);
+          end += q->sec_cnt;
+          sec_cnt += q->sec_cnt;
+        }
+    }
+}
+
+/* Fills channel C's physical region descriptor table with the
+   buffers of the requests in its batch.  Kernel virtual memory
+   maps physical memory linearly, so each buffer is physically
+   contiguous and need only be split at 64 kB boundaries. */
+static void
+setup_prdt (struct channel *c) 
+{
+  struct prd *prd = c->prdt;
+  struct list_elem *e;
+
+  for (e = list_begin (&c->batch); e != list_end (&c->batch);
+       e = list_next (e)) 
+    {
+      struct disk_request *r = list_entry (e, struct disk_request, elem);
+      uintptr_t addr, end;
+
+      ASSERT (is_kernel_vaddr (r->buffer));
+      addr = vtop (r->buffer);
+      end = addr + r->sec_cnt * DISK_SECTOR_SIZE;
+      while (addr < end) 
+        {
+          uintptr_t limit = (addr / PRD_BOUNDARY + 1) * PRD_BOUNDARY;
+          uintptr_t next = end < limit ? end : limit;
+
+          ASSERT (prd < c->prdt + PGSIZE / sizeof *prd);
+          prd->addr = addr;
+          prd->size = next - addr;      /* 64 kB wraps to 0, as intended. */
+          prd->flags = 0;
+          prd++;
+          addr = next;
+        }
+    }
+  prd[-1].flags = PRD_EOT;
+}
+
+/* Transfers the next block of channel C's command in progress
+   between the data register and the requests' buffers.  A block
+   is one sector, or D->multiple sectors with READ/WRITE
+   MULTIPLE. */
+static void
+transfer_block (struct channel *c) 
+{
+  struct disk_request *r = c->xfer_req;
+  size_t block = r->disk->multiple > 0 ? (size_t) r->disk->multiple : 1;
+  size_t left = c->xfer_cnt - c->xfer_done;
+  size_t i;
+
+  for (i = 0; i < block && i < left; i++) 
+    {
+      if (c->xfer_ofs == r->sec_cnt) 
+        {
+          r = list_entry (list_next (&r->elem), struct disk_request, elem);
+          c->xfer_req = r;
+          c->xfer_ofs = 0;
+        }
+      if (r->write)
+        output_sector (c, r->buffer + c->xfer_ofs * DISK_SECTOR_SIZE);
+      else
+        input_sector (c, r->buffer + c->xfer_ofs * DISK_SECTOR_SIZE);
+      c->xfer_ofs++;
+      c->xfer_done++;
+    }
+}
+
+/* Handles a completion interrupt for channel C's command in
+   progress.  A read interrupt means a block is ready to be read;
+   a write interrupt means the last block was accepted. */
+static void
+service_interrupt (struct channel *c) 
+{
+  struct disk_request *first = list_entry (list_front (&c->batch),
+                                           struct disk_request, elem);
+  struct disk *d = first->disk;
+
+  if (c->xfer_dma) 
+    {
+      uint8_t bm_status = inb (reg_bm_status (c));
+
+      /* Stop the bus master and acknowledge its interrupt. */
+      outb (reg_bm_command (c), first->write ? 0 : BM_READ);
+      outb (reg_bm_status (c), BM_ERROR | BM_IRQ);
+      if ((bm_status & BM_ERROR) != 0
+          || (inb (reg_alt_status (c)) & STA_ERR) != 0)
+        PANIC ("%s: disk DMA %s failed, sector=%"PRDSNu, d->name,
+               first->write ? "write" : "read", first->sec_no);
+      c->xfer_done = c->xfer_cnt;
+      finish_command (c);
+      return;
+    }
+
+  if (!first->write)
+    {
+      if (!poll_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu,
+               d->name, first->sec_no + c->xfer_done);
+      transfer_block (c);
+    }
+
+  if (c->xfer_done < c->xfer_cnt) 
+    {
+      if (first->write) 
+        {
+          if (!poll_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, first->sec_no + c->xfer_done);
+          transfer_block (c);
+        }
+      return;
+    }
+
+  finish_command (c);
+}
+
+/* Completes the requests in channel C's finished command and
+   starts the next command, if any. */
+static void
+finish_command (struct channel *c) 
+{
+  struct disk_request *first = list_entry (list_front (&c->batch),
+                                           struct disk_request, elem);
+  struct disk *d = first->disk;
+  struct list done;
+
+  if (first->write)
+    d->write_cnt += c->xfer_cnt;
+  else
+    d->read_cnt += c->xfer_cnt;
+  c->head = request_position (first) + c->xfer_cnt;
+  c->expecting_interrupt = false;
+
+  /* Empty the batch before running callbacks, which may submit
+     new requests. */
+  list_init (&done);
+  while (!list_empty (&c->batch))
+    list_push_back (&done, list_pop_front (&c->batch));
+  while (!list_empty (&done)) 
+    {
+      struct disk_request *r = list_entry (list_pop_front (&done),
+                                           struct disk_request, elem);
+      if (r->callback != NULL)
+        r->callback (r, r->aux);
+      sema_up (&r->done);
+    }
+
+  start_command (c);
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -388,6 +842,20 @@ identify_ata_device (struct disk *d)
   /* Calculate capacity. */
   d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+  /* Use DMA if both the device (IDENTIFY word 49, bit 8) and the
+     controller support it. */
+  d->dma = c->bm_base != 0 && (id[49] & 0x0100) != 0;
+
+  /* Enable READ/WRITE MULTIPLE with the largest block size the
+     device supports, which must be a power of 2. */
+  if ((id[47] & 0xff) > 1) 
+    {
+      int block = 1;
+      while (block * 2 <= (id[47] & 0xff))
+        block *= 2;
+      set_multiple_mode (d, block);
+    }
+
   /* Print identification message. */
   printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
   if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -406,6 +874,88 @@ identify_ata_device (struct disk *d)
   printf ("\"\n");
 }
 
+/* Sends a SET MULTIPLE MODE command to disk D asking for BLOCK
+   sectors per READ/WRITE MULTIPLE interrupt.  Sets D's multiple
+   member to BLOCK if the device accepts, otherwise leaves it at
+   0 so that plain READ/WRITE SECTOR commands are used. */
+static void
+set_multiple_mode (struct disk *d, int block) 
+{
+  struct channel *c = d->channel;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), block);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_status (c)) & STA_ERR) == 0)
+    d->multiple = block;
+}
+
+/* PCI configuration space access, used only to find the IDE
+   controller's bus master registers.  See [PCI]. */
+#define PCI_CONFIG_ADDR 0xcf8   /* Configuration address port. */
+#define PCI_CONFIG_DATA 0xcfc   /* Configuration data port. */
+
+/* Reads the 32-bit configuration register at byte offset REG of
+   PCI function FUNC of device DEV on bus BUS. */
+static uint32_t
+pci_read_config (int bus, int dev, int func, int reg) 
+{
+  outl (PCI_CONFIG_ADDR, 0x80000000 | (bus << 16) | (dev << 11)
+        | (func << 8) | (reg & 0xfc));
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to the 32-bit configuration register at byte
+   offset REG of PCI function FUNC of device DEV on bus BUS. */
+static void
+pci_write_config (int bus, int dev, int func, int reg, uint32_t value) 
+{
+  outl (PCI_CONFIG_ADDR, 0x80000000 | (bus << 16) | (dev << 11)
+        | (func << 8) | (reg & 0xfc));
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Looks on PCI bus 0 for an IDE controller capable of bus
+   mastering, as emulated by QEMU and Bochs (a PIIX).  If found,
+   enables bus mastering and returns the base I/O port of its
+   bus master registers (channel 0 at the base, channel 1 eight
+   ports above it); otherwise returns 0, and all transfers use
+   PIO. */
+static uint16_t
+find_bus_master (void) 
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++) 
+      {
+        uint32_t id = pci_read_config (0, dev, func, 0x00);
+        uint32_t class = pci_read_config (0, dev, func, 0x08);
+        uint32_t bar4;
+
+        if ((id & 0xffff) == 0xffff)
+          continue;
+
+        /* Class 1 (mass storage), subclass 1 (IDE), with bit 7
+           of the programming interface (bus master) set. */
+        if ((class >> 16) != 0x0101 || (class & 0x8000) == 0)
+          continue;
+
+        /* BAR4 must be an I/O space BAR. */
+        bar4 = pci_read_config (0, dev, func, 0x20);
+        if ((bar4 & 1) == 0 || (bar4 & 0xfffc) == 0)
+          continue;
+
+        /* Enable I/O space access and bus mastering. */
+        pci_write_config (0, dev, func, 0x04,
+                          pci_read_config (0, dev, func, 0x04) | 0x05);
+        return bar4 & 0xfffc;
+      }
+  return 0;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -428,18 +978,19 @@ print_ata_string (char *string, size_t size)
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and SEC_CNT to the disk's sector selection and
+   sector count registers.  (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) 
+select_sector (struct disk *d, disk_sector_t sec_no, size_t sec_cnt) 
 {
   struct channel *c = d->channel;
-  // printf("SEC NO : %x\n", sec_no);
+  ASSERT (sec_cnt > 0 && sec_cnt <= MAX_SECTORS);
   ASSERT (sec_no < d->capacity);
+  ASSERT (sec_cnt <= d->capacity - sec_no);
   ASSERT (sec_no < (1UL << 28));
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), sec_cnt == MAX_SECTORS ? 0 : sec_cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -492,7 +1043,7 @@ wait_until_idle (const struct disk *d)
     {
       if ((inb (reg_status (d->channel)) & (STA_BSY | STA_DRQ)) == 0)
         return;
-      timer_usleep (10);
+      timer_udelay (10);
     }
 
   printf ("%s: idle timeout\n", d->name);
@@ -525,6 +1076,29 @@ wait_while_busy (const struct disk *d)
   return false;
 }
 
+/* Busy-waits up to 100 ms for disk D to clear BSY, and then
+   returns the status of the DRQ bit.  Unlike wait_while_busy(),
+   usable with interrupts off.  Outside of a reset, a device that
+   has just raised an interrupt or accepted a command clears BSY
+   almost at once. */
+static bool
+poll_while_busy (const struct disk *d) 
+{
+  struct channel *c = d->channel;
+  int i;
+
+  for (i = 0; i < 10000; i++)
+    {
+      uint8_t status = inb (reg_alt_status (c));
+      if (!(status & STA_BSY))
+        return (status & STA_DRQ) != 0;
+      timer_udelay (10);
+    }
+
+  printf ("%s: busy timeout\n", d->name);
+  return false;
+}
+
 /* Program D's channel so that D is now the selected disk. */
 static void
 select_device (const struct disk *d)
@@ -535,7 +1109,7 @@ select_device (const struct disk *d)
     dev |= DEV_DEV;
   outb (reg_device (c), dev);
   inb (reg_alt_status (c));
-  timer_nsleep (400);
+  timer_ndelay (400);
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
@@ -557,7 +1131,12 @@ interrupt_handler (struct intr_frame *f)
   for (c = channels; c < channels + CHANNEL_CNT; c++)
     if (f->vec_no == c->irq)
       {
-        if (c->expecting_interrupt) 
+        if (!list_empty (&c->batch)) 
+          {
+            inb (reg_status (c));               /* Acknowledge interrupt. */
+            service_interrupt (c);              /* Continue command. */
+          }
+        else if (c->expecting_interrupt) 
           {
             inb (reg_status (c));               /* Acknowledge interrupt. */
             sema_up (&c->completion_wait);      /* Wake up waiter. */
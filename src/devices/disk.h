@@ -2,7 +2,11 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -15,6 +19,29 @@ typedef uint32_t disk_sector_t;
    printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+struct disk_request;
+
+/* Called from the disk interrupt handler when request R
+   completes.  Must not sleep. */
+typedef void disk_callback_func (struct disk_request *r, void *aux);
+
+/* An asynchronous disk request.
+   The submitter provides the storage, which must remain valid
+   until the request completes. */
+struct disk_request
+  {
+    struct disk *disk;          /* Target disk. */
+    disk_sector_t sec_no;       /* First sector to transfer. */
+    size_t sec_cnt;             /* Number of sectors to transfer. */
+    uint8_t *buffer;            /* SEC_CNT * DISK_SECTOR_SIZE bytes. */
+    bool write;                 /* True for a write, false for a read. */
+    int64_t deadline;           /* Tick by which it should be served. */
+    disk_callback_func *callback;       /* Called on completion. */
+    void *aux;                  /* Passed to CALLBACK. */
+    struct semaphore done;      /* Up'd on completion. */
+    struct list_elem elem;      /* Element in channel's queue. */
+  };
+
 void disk_init (void);
 void disk_print_stats (void);
 
@@ -22,5 +49,13 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multiple (struct disk *, disk_sector_t, void *, size_t);
+void disk_write_multiple (struct disk *, disk_sector_t, const void *, size_t);
+
+void disk_request_init (struct disk_request *, struct disk *, disk_sector_t,
+                        void *buffer, size_t sec_cnt, bool write,
+                        disk_callback_func *, void *aux);
+void disk_submit (struct disk_request *);
+void disk_wait (struct disk_request *);
 
 #endif /* devices/disk.h */
@@ -1,6 +1,7 @@
 #include "filesys/cache.h"
 #include "devices/timer.h"
 #include "threads/thread.h"
+#include "threads/interrupt.h"
 #include <string.h>
 #include <debug.h>
 #include <stdlib.h>
@@ -10,8 +11,13 @@
 void * read_ahead_buffer;
 extern struct thread* read_ahead_thread;
 disk_sector_t read_ahead_sec = 0;
+struct disk_request read_ahead_req;    /* read ahead request in flight */
+bool read_ahead_pending = false;       /* true until read_ahead_buffer is consumed */
+static struct semaphore read_ahead_sema; /* upped when read_ahead_req completes */
+static bool read_ahead_stale;          /* sector written while being read ahead */
+struct disk_request flush_req[64];     /* write back requests of flush all */
 
-int read_ahead_flag = 1;
+static void read_ahead_done(struct disk_request *r, void *aux);
 
 void buffer_cache_init(void)
 {
@@ -19,6 +25,7 @@ void buffer_cache_init(void)
 
 	sema_down(&cache_sema);
 	read_ahead_buffer = calloc(1, 512);
+	sema_init(&read_ahead_sema, 0);
 	
 
 	int i = 0;
@@ -78,11 +85,23 @@ void buffer_cache_flush(int index)
 void buffer_cache_flush_all(void)
 {
 	int i=0;
+	bool submitted[64];
 	sema_down(&cache_sema);
+	/* submit every dirty entry first, so the disk can sort and
+	   merge them, then wait for all of them */
 	for (; i<64; i++)
 	{
-		if(buffer_cache[i].dirty)
-			buffer_cache_flush(i);
+		submitted[i] = buffer_cache[i].dirty;
+		if(!submitted[i])
+			continue;
+		disk_request_init(&flush_req[i], disk_get(0,1), buffer_cache[i].sec_num, buffer_cache[i].buffer, 1, true, NULL, NULL);
+		disk_submit(&flush_req[i]);
+		buffer_cache[i].dirty = false;
+	}
+	for (i=0; i<64; i++)
+	{
+		if(submitted[i])
+			disk_wait(&flush_req[i]);
 	}
 	sema_up(&cache_sema);
 }
@@ -123,6 +142,8 @@ void buffer_cache_write(disk_sector_t sector, void *buffer)
 
 	// sema_down(&cache_sema);
 
+	if(read_ahead_pending && sector == read_ahead_sec)
+		read_ahead_stale = true;
 	buffer_cache[buffer_cache_idx].dirty = true;
 	buffer_cache[buffer_cache_idx].access_time = timer_ticks();
 	memmove(buffer_cache[buffer_cache_idx].buffer, buffer, DISK_SECTOR_SIZE);
@@ -173,38 +194,61 @@ void periodic_flush_all(void)
 
 void read_ahead(disk_sector_t sector)
 {	
+	struct disk *d = disk_get(0,1);
+	enum intr_level old_level;
+
+	/* only one read ahead in flight, and the reader never waits for it */
+	if(sector + 1 >= disk_size(d))
+		return;
+	old_level = intr_disable();
+	if(read_ahead_pending)
+	{
+		intr_set_level(old_level);
+		return;
+	}
+	read_ahead_pending = true;
+	intr_set_level(old_level);
 	read_ahead_sec = sector + 1;
 	// printf("THREAD CREATE\n");
 	// sema_down(&cache_sema);
-	disk_read(disk_get(0,1), sector, read_ahead_buffer);
-	read_ahead_flag = 2;
+	disk_request_init(&read_ahead_req, d, read_ahead_sec, read_ahead_buffer, 1, false, read_ahead_done, NULL);
+	disk_submit(&read_ahead_req);
 	
 	// free(read_ahead_buffer);
 	// sema_up(&cache_sema);
 	// printf("THREAD PASS\n");
 }
 
+/* completion of read_ahead_req, runs in the disk interrupt handler */
+static void read_ahead_done(struct disk_request *r UNUSED, void *aux UNUSED)
+{
+	sema_up(&read_ahead_sema);
+}
+
+/* Read ahead thread: sleeps until a read ahead completes, then
+   enters the sector into the cache unless it is there already or
+   was written meanwhile, and lets the next read ahead be
+   submitted. */
 void read_ahead_func(void)
 {
-	// sema_down(&cache_sema);
 	while(true){
+		sema_down(&read_ahead_sema);
 
-		while(read_ahead_flag = 1)
-		{
-			thread_yield();
-		}
-
+		sema_down(&cache_sema);
 		disk_sector_t sector = read_ahead_sec;
 		int buffer_idx = buffer_cache_find(sector);
-		// timer_sleep(1000);
-		if(buffer_idx == -1){
+		if(buffer_idx == -1 && !read_ahead_stale){
 			buffer_idx = buffer_cache_lru_eviction();
 			buffer_cache[buffer_idx].used = true;
 			buffer_cache[buffer_idx].dirty = false;
 			buffer_cache[buffer_idx].sec_num = sector;
 			memmove(buffer_cache[buffer_idx].buffer, read_ahead_buffer, DISK_SECTOR_SIZE);
 		}
-		read_ahead_flag = 1;
+		sema_up(&cache_sema);
+
+		/* read_ahead_buffer is free for the next one */
+		read_ahead_stale = false;
+		read_ahead_pending = false;
 	}
 	// sema_up(&cache_sema);
 	// timer_sleep(10);
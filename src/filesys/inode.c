@@ -160,6 +160,7 @@ inode_open (disk_sector_t sector)
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->write_gen = 0;
   inode->removed = false;
   // disk_read (filesys_disk, inode->sector, &inode->data);
   buffer_cache_read(inode->sector, &inode->data);
@@ -182,6 +183,14 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns INODE's write generation, which changes whenever
+   INODE is written to or removed. */
+unsigned
+inode_write_gen (const struct inode *inode)
+{
+  return inode->write_gen;
+}
+
 /* Closes INODE and writes it to disk.
    If this was the last reference to INODE, frees its memory.
    If INODE was also a removed inode, frees its blocks. */
@@ -217,6 +226,7 @@ inode_remove (struct inode *inode)
 {
   ASSERT (inode != NULL);
   inode->removed = true;
+  inode->write_gen++;
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -293,6 +303,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   if (inode->deny_write_cnt)
     return 0;
+  inode->write_gen++;
 
 
   /* file extension */
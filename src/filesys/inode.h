@@ -41,6 +41,7 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned write_gen;                 /* Bumped on every write. */
     struct inode_disk data;             /* Inode content. */
     struct inode *parent;               /* advance directory inode */
   };
@@ -51,6 +52,7 @@ bool inode_create (disk_sector_t sector, off_t length, bool directory);
 struct inode *inode_open (disk_sector_t);
 struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
+unsigned inode_write_gen (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
@@ -0,0 +1,16 @@
+#ifndef __LIB_SPAWN_H
+#define __LIB_SPAWN_H
+
+/* Most entries in a spawn() file descriptor map. */
+#define SPAWN_FD_MAX 16
+
+/* One entry of a spawn() file descriptor map: the child starts
+   with the caller's open file PARENT_FD open as CHILD_FD, at the
+   same position.  CHILD_FD must be above the console's. */
+struct spawn_fd
+  {
+    int child_fd;               /* Descriptor in the child. */
+    int parent_fd;              /* Descriptor in the caller. */
+  };
+
+#endif /* lib/spawn.h */
@@ -28,7 +28,17 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Statistics. */
+    SYS_VMSTAT,                 /* Reports virtual memory statistics. */
+    SYS_RSSLIMIT,               /* Sets the resident set size limit. */
+    SYS_MAPLARGE,               /* Maps a 4 MB page. */
+
+    /* Process batches. */
+    SYS_SPAWN,                  /* Start a process with a descriptor map. */
+    SYS_WAIT_ANY,               /* Wait for one of several children. */
+    SYS_WAIT_ALL                /* Wait for several children. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -182,3 +182,39 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+vmstat (struct vmstat *st)
+{
+  return syscall1 (SYS_VMSTAT, st);
+}
+
+int
+rsslimit (int pages)
+{
+  return syscall1 (SYS_RSSLIMIT, pages);
+}
+
+bool
+map_large (void *addr)
+{
+  return syscall1 (SYS_MAPLARGE, addr);
+}
+
+pid_t
+spawn (const char *file, const struct spawn_fd *fds, int fd_cnt)
+{
+  return (pid_t) syscall3 (SYS_SPAWN, file, fds, fd_cnt);
+}
+
+pid_t
+wait_any (const pid_t *pids, int cnt, int *status)
+{
+  return (pid_t) syscall3 (SYS_WAIT_ANY, pids, cnt, status);
+}
+
+bool
+wait_all (const pid_t *pids, int cnt, int *status)
+{
+  return syscall3 (SYS_WAIT_ALL, pids, cnt, status);
+}
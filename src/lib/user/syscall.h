@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <vmstat.h>
+#include <spawn.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +47,14 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Statistics. */
+bool vmstat (struct vmstat *);
+int rsslimit (int pages);
+bool map_large (void *addr);
+
+/* Process batches. */
+pid_t spawn (const char *file, const struct spawn_fd *fds, int fd_cnt);
+pid_t wait_any (const pid_t *pids, int cnt, int *status);
+bool wait_all (const pid_t *pids, int cnt, int *status);
+
 #endif /* lib/user/syscall.h */
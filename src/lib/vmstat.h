@@ -0,0 +1,44 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Virtual memory statistics, as reported by the vmstat system
+   call.  Counters are cumulative since boot, except where noted
+   otherwise. */
+struct vmstat
+  {
+    /* Page faults, by the way they were resolved. */
+    long long faults;           /* All page faults. */
+    long long lazy_faults;      /* Loaded from a file. */
+    long long stack_faults;     /* Stack growth. */
+    long long swapin_faults;    /* Read back from swap. */
+    long long cow_faults;       /* Copy-on-write breaks. */
+    long long zero_faults;      /* Mapped to the shared zero frame. */
+    long long around_pages;     /* Mapped by fault-around, no fault. */
+
+    /* Page replacement. */
+    long long evictions;        /* Frames reclaimed. */
+    long long pageins;          /* Pages read from swap. */
+    long long pageouts;         /* Pages written to swap. */
+    long long writebacks;       /* Mapped pages written to their file. */
+    long long zero_pageouts;    /* All-zero pages evicted without I/O. */
+    long long swap_read_ticks;  /* Timer ticks spent waiting on swap reads. */
+    long long swap_write_ticks; /* Timer ticks spent waiting on swap writes. */
+    long long zpageins;         /* Pages decompressed from the pool. */
+    long long zpageouts;        /* Pages compressed into the pool. */
+
+    /* Current state. */
+    int swap_slots;             /* Swap slots, one page each. */
+    int swap_used;              /* Swap slots in use. */
+    int swap_peak;              /* High-water mark of swap_used. */
+    int swap_free_runs;         /* Runs of contiguous free slots. */
+    int zpool_size;             /* Bytes in the compressed pool. */
+    int zpool_used;             /* Bytes of the pool in use. */
+    int zpool_pages;            /* Pages held in the pool. */
+    int frames_used;            /* User frames in the frame table. */
+    int frames_free;            /* Free pages in the user pool. */
+    int rss;                    /* Resident pages of the caller. */
+    int ws_size;                /* Working set estimate of the caller. */
+    int rss_limit;              /* RSS limit of the caller, 0 if none. */
+  };
+
+#endif /* lib/vmstat.h */
@@ -0,0 +1,42 @@
+/* Spawns several child processes and waits for them as a batch,
+   first for any one of them, then for all of the rest. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void)
+{
+  pid_t pids[CHILD_CNT];
+  int status[CHILD_CNT];
+  pid_t first;
+  int first_status;
+  int i, j;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pids[i] = spawn ("child-simple", NULL, 0);
+      if (pids[i] == PID_ERROR)
+        fail ("spawn returned %d", pids[i]);
+    }
+
+  /* Messages wait until every child is done, so that they do not
+     mix with the children's. */
+  first = wait_any (pids, CHILD_CNT, &first_status);
+  for (i = j = 0; i < CHILD_CNT; i++)
+    if (pids[i] != first)
+      pids[j++] = pids[i];
+  if (j != CHILD_CNT - 1)
+    fail ("wait_any returned %d", first);
+  if (!wait_all (pids, j, status))
+    fail ("wait_all failed");
+
+  msg ("wait_any: %d", first_status);
+  for (i = 0; i < j; i++)
+    msg ("wait_all: %d", status[i]);
+  if (wait_any (pids, j, &first_status) != PID_ERROR)
+    fail ("waited for a child twice");
+}
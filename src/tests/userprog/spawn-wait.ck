@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(spawn-wait) begin
+(child-simple) run
+(child-simple) run
+(child-simple) run
+(child-simple) run
+(spawn-wait) wait_any: 81
+(spawn-wait) wait_all: 81
+(spawn-wait) wait_all: 81
+(spawn-wait) wait_all: 81
+(spawn-wait) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Touches pages of a large zeroed array and checks that the
+   vmstat system call reports the faults and the resident pages
+   that this caused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 16
+
+/* Only written, so volatile, or the writes would be optimized
+   away. */
+static volatile char buf[PAGE_CNT * 4096];
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  size_t i;
+
+  CHECK (vmstat (&before), "vmstat");
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * 4096] = 1;
+  CHECK (vmstat (&after), "vmstat");
+
+  if (after.faults - before.faults < PAGE_CNT)
+    fail ("%lld faults for %d pages", after.faults - before.faults, PAGE_CNT);
+  if (after.lazy_faults <= before.lazy_faults)
+    fail ("no lazy load faults counted");
+  if (after.rss - before.rss < PAGE_CNT)
+    fail ("rss grew by %d for %d pages", after.rss - before.rss, PAGE_CNT);
+  if (after.swap_used > after.swap_slots || after.swap_peak < after.swap_used)
+    fail ("%d of %d swap slots used, %d peak",
+          after.swap_used, after.swap_slots, after.swap_peak);
+}
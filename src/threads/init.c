@@ -37,6 +37,7 @@
 #endif
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/swap.h"
 #include "filesys/cache.h"
 
 /* Amount of physical memory, in 4 kB pages. */
@@ -45,6 +46,12 @@ size_t ram_pages;
 /* Page directory with kernel mappings only. */
 uint32_t *base_page_dir;
 
+/* 4 MB pages are in use. */
+bool pse_enabled;
+
+/* CR4 flag that enables 4 MB pages. */
+#define CR4_PSE 0x10
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -55,9 +62,14 @@ bool power_off_when_done;
 
 static void ram_init (void);
 static void paging_init (void);
+static bool cpu_has_pse (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
+#ifdef VM
+static void parse_swap_disks (char *value);
+static void parse_replace (const char *value);
+#endif
 static void run_actions (char **argv);
 static void usage (void);
 
@@ -96,7 +108,6 @@ main (void)
   frame_init();
   page_init();
   swap_init();
-  swapdisk_bitmap_init();
 
 
   /* Segmentation. */
@@ -113,6 +124,7 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  process_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
@@ -124,9 +136,17 @@ main (void)
   /* Initialize file system. */
 
   disk_init ();
+  swapdisk_bitmap_init ();
+#ifdef VM
+  zswap_init ();
+#endif
   
   filesys_init (format_filesys);
   thread_create("periodic", PRI_DEFAULT, periodic_flush_all, NULL);
+#ifdef VM
+  if (pageout_daemon)
+    frame_pageout_init ();
+#endif
   
 
 
@@ -179,6 +199,7 @@ paging_init (void)
   size_t page;
   extern char _start, _end_kernel_text;
 
+  pse_enabled = cpu_has_pse ();
   pd = base_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
   for (page = 0; page < ram_pages; page++) 
@@ -189,6 +210,18 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      /* Map each whole 4 MB of RAM with a single PDE, except the
+         one holding the kernel text, which keeps 4 kB pages so
+         that the text stays read-only. */
+      if (pse_enabled && paddr % PTSPAN == 0
+          && page + PTSPAN / PGSIZE <= ram_pages
+          && (vaddr + PTSPAN <= &_start || &_end_kernel_text <= vaddr))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true, false);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -198,6 +231,14 @@ paging_init (void)
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
 
+  /* PDEs with PTE_PS set are only understood once PSE is on. */
+  if (pse_enabled)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -206,6 +247,17 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (base_page_dir)));
 }
 
+/* Returns true if the CPU supports 4 MB pages, according to
+   CPUID.  See [IA32-v2a] "CPUID--CPU Identification". */
+static bool
+cpu_has_pse (void) 
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & (1 << 3)) != 0;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -267,6 +319,22 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-swap"))
+        parse_swap_disks (value);
+      else if (!strcmp (name, "-pageout"))
+        pageout_daemon = true;
+      else if (!strcmp (name, "-zswap"))
+        zswap_pages = atoi (value);
+      else if (!strcmp (name, "-rss"))
+        {
+          frame_rss_limit = atoi (value);
+          if (frame_rss_limit > 0 && frame_rss_limit < FRAME_RSS_MIN)
+            frame_rss_limit = FRAME_RSS_MIN;
+        }
+      else if (!strcmp (name, "-replace"))
+        parse_replace (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -275,6 +343,39 @@ parse_options (char **argv)
   return argv;
 }
 
+#ifdef VM
+/* Parses VALUE, a comma-separated list of CHAN:DEV disk names
+   such as "1:1,0:0", and adds each disk to the swap disks. */
+static void
+parse_swap_disks (char *value) 
+{
+  char *disk, *save_ptr;
+
+  if (value == NULL)
+    PANIC ("-swap requires a list of disks");
+  for (disk = strtok_r (value, ",", &save_ptr); disk != NULL;
+       disk = strtok_r (NULL, ",", &save_ptr)) 
+    {
+      char *colon = strchr (disk, ':');
+      if (colon == NULL)
+        PANIC ("bad swap disk `%s' (use CHAN:DEV)", disk);
+      swap_add_disk (atoi (disk), atoi (colon + 1));
+    }
+}
+
+/* Parses VALUE, the page replacement policy. */
+static void
+parse_replace (const char *value) 
+{
+  if (value != NULL && !strcmp (value, "global"))
+    frame_local_replace = false;
+  else if (value != NULL && !strcmp (value, "local"))
+    frame_local_replace = true;
+  else
+    PANIC ("-replace requires `global' or `local'");
+}
+#endif
+
 /* Runs the task specified in ARGV[1]. */
 static void
 run_task (char **argv)
@@ -371,6 +472,14 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -swap=DISK[,...]   Swap to DISKs, given as CHAN:DEV (default 1:1).\n"
+          "  -pageout           Evict pages in a background page-out daemon.\n"
+          "  -zswap=PAGES       Keep evicted pages compressed in PAGES of RAM.\n"
+          "  -rss=PAGES         Limit each process to PAGES resident pages.\n"
+          "  -replace=POLICY    Evict from all processes (global, default)\n"
+          "                     or from the faulting one (local).\n"
 #endif
           );
   power_off ();
@@ -14,6 +14,9 @@ extern size_t ram_pages;
 /* Page directory with kernel mappings only. */
 extern uint32_t *base_page_dir;
 
+/* True if 4 MB pages are enabled (the CPU supports PSE). */
+extern bool pse_enabled;
+
 /* -q: Power off when kernel tasks complete? */
 extern bool power_off_when_done;
 
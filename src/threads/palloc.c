@@ -9,6 +9,7 @@
 #include <string.h>
 #include "threads/init.h"
 #include "threads/loader.h"
+#include "threads/pte.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -107,6 +108,46 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
+/* Obtains a 4 MB page, that is, PTSPAN / PGSIZE contiguous free
+   pages that start on a 4 MB boundary in physical memory, so
+   that a single PDE can map them.  FLAGS are as for
+   palloc_get_multiple().  Free the page with
+   palloc_free_multiple(). */
+void *
+palloc_get_large (enum palloc_flags flags) 
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t page_cnt = PTSPAN / PGSIZE;
+  size_t base_idx = vtop (pool->base) / PGSIZE;
+  size_t page_idx;
+  void *pages = NULL;
+
+  lock_acquire (&pool->lock);
+  for (page_idx = ROUND_UP (base_idx, page_cnt) - base_idx;
+       page_idx + page_cnt <= bitmap_size (pool->used_map);
+       page_idx += page_cnt)
+    if (bitmap_none (pool->used_map, page_idx, page_cnt)) 
+      {
+        bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+        pages = pool->base + PGSIZE * page_idx;
+        break;
+      }
+  lock_release (&pool->lock);
+
+  if (pages != NULL) 
+    {
+      if (flags & PAL_ZERO)
+        memset (pages, 0, PGSIZE * page_cnt);
+    }
+  else 
+    {
+      if (flags & PAL_ASSERT)
+        PANIC ("palloc_get_large: out of pages");
+    }
+
+  return pages;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -120,6 +161,20 @@ palloc_get_page (enum palloc_flags flags)
   return palloc_get_multiple (flags, 1);
 }
 
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free_cnt (void) 
+{
+  size_t cnt;
+
+  lock_acquire (&user_pool.lock);
+  cnt = bitmap_count (user_pool.used_map, 0,
+                      bitmap_size (user_pool.used_map), false);
+  lock_release (&user_pool.lock);
+
+  return cnt;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
@@ -149,6 +149,9 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+#ifdef VM
+  frame_print_stats ();
+#endif
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -208,8 +211,9 @@ thread_create (const char *name, int priority,
   // enum intr_level old_level = intr_disable();
   list_push_back(&thread_current()->child_list, &t->elem);
  
-  page_table_init(&t->pt);
-  swap_table_init(&t->st);
+  page_table_init(t);
+  swap_table_init(t);
+  t->rss_limit = frame_rss_limit;
   t->parent->child_num += 1;
 
   // sema_up(&t->parent->sema);
@@ -487,9 +491,14 @@ init_thread (struct thread *t, const char *name, int priority)
   list_init(&t->child_list);
   sema_init(&t->sema, 0);
   sema_init(&t->main_sema, 0);
+  list_init(&t->spawn_list);
+  cond_init(&t->spawn_cond);
+  t->spawn = NULL;
+  t->spawn_start = NULL;
 
   t->esp = PHYS_BASE - 4;
   list_init(&t->mmf_list);
+  list_init(&t->vma_list);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
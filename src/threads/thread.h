@@ -111,14 +111,24 @@ struct thread
     char* exec;                         /*execuatable file for load */ 
     uint32_t* stack_end;
     int wait_num;
+    struct list spawn_list;             /* Children started by spawn */
+    struct condition spawn_cond;        /* Signaled when one of them exits */
+    struct spawn_child *spawn;          /* Own entry, if spawned */
+    struct spawn_start *spawn_start;    /* Spawn in progress, if any */
 #endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
-    struct hash pt;                     /* Page table. */
+    struct page_table_entry ***pt;      /* Supplemental page table. */
     struct hash st;                     /* Swap table. */
+    struct lock st_lock;                /* Guards st, which evicting
+                                           threads update too. */
     uint32_t *esp;                      /* Saved ESP register value */
     struct list mmf_list;               /* memory mapped file list */
+    struct list vma_list;               /* lazily loaded ranges */
+    int rss;                            /* frames owned */
+    int rss_limit;                      /* most frames to own, 0 if any */
+    int ws_size;                        /* working set estimate, in pages */
 
     struct dir * pwd;                   /* present working directroy */            
   };
@@ -8,6 +8,7 @@
 #include "threads/vaddr.h"
 #include "userprog/process.h"
 #include "vm/page.h"
+#include "vm/frame.h"
 #include "devices/disk.h"
 #include "filesys/file.h"
 
@@ -155,6 +156,7 @@ page_fault (struct intr_frame *f)
   else esp = thread_current()->esp;
 
   page_fault_cnt++;
+  vm_stat.faults++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
@@ -178,19 +180,39 @@ page_fault (struct intr_frame *f)
     syscall_exit(-1);
 
   if(!not_present)
+  {
+    /* write to a copy-on-write page */
+    if(write && page_cow(pg_round_down(fault_addr)))
+    {
+      vm_stat.cow_faults++;
+      return;
+    }
     syscall_exit(-1);
+  }
 
   /* check whether the case is stack growth */
 
-  PTE* result = page_pte_lookup(pg_round_down(fault_addr));
+  PTE* result = page_pte_get(pg_round_down(fault_addr));
+
+  /* a page being evicted is faulted in again once it is out */
+  if(result != NULL && result->in_transit)
+    swap_transit_wait(result);
   // printf("WRITE : %d USER : %d not_present : %d \n", write, user, not_present);
   // printf("UADDR : %p\n", result->uaddr);
   
 
   if(result != NULL && !result->load_result && result->load)
   {
+    /* reading a page of zeros maps the shared zero frame */
+    if(!write && page_zero_map(result->uaddr))
+    {
+      vm_stat.zero_faults++;
+      return;
+    }
+    vm_stat.lazy_faults++;
     if(!actual_load(result->uaddr))
-      printf("actual_load: FAILED");
+      syscall_exit(-1);
+    page_fault_around(result->uaddr);
     // printf("COME HERE\n");
     return;
   }
@@ -205,7 +227,15 @@ page_fault (struct intr_frame *f)
     uint32_t *kpage;
     struct file *file = thread_current()->file;
 
+    vm_stat.stack_faults++;
+    if(!write && page_zero_map(pg_round_down(fault_addr)))
+    {
+      vm_stat.zero_faults++;
+      return;
+    }
     kpage = stack_growth(fault_addr);
+    if(kpage == NULL)
+      syscall_exit(-1);
 
     return;
   }
@@ -218,29 +248,11 @@ page_fault (struct intr_frame *f)
 
   if( result->is_swapped_out )
   {
-
-    // printf("esp  viction\n");
-    uint32_t *temp;
-    // printf("EVICTION OCCUR\n");
-    /* check whether there is no free frame */
-    temp = palloc_get_page(PAL_USER | PAL_ZERO);
-    if(temp == NULL)
-    {
-      /* find some frame that occupies PM by eviction policy */
-      // printf("fifo occur (exn 207)\n");
-      FTE *fte = frame_fifo_fte();
-      
-      // printf("UADDR : %x\n", fte->uaddr);
-      /* swap out the frame to disk and record it to swap table */ 
-      if(fte != NULL)
-        swap_out(fte->uaddr);
-    }
-    if(temp !=NULL){
-         palloc_free_page(temp);
-    }
-
-    /* swap in the frame which is originally mapped with the page */
-    swap_in(pg_round_down(fault_addr)); 
+    /* swap in the frame which is originally mapped with the page;
+       swap_in() evicts another one if none is free */
+    vm_stat.swapin_faults++;
+    if(!swap_in(pg_round_down(fault_addr)))
+      syscall_exit(-1);
     return;
   }
 
@@ -34,7 +34,9 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != base_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
+    if ((*pde & PTE_P) && (*pde & PTE_PS))
+      palloc_free_multiple (pde_get_page (*pde), PTSPAN / PGSIZE);
+    else if (*pde & PTE_P) 
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
@@ -52,7 +54,10 @@ pagedir_destroy (uint32_t *pd)
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   pointer is returned.
+   If VADDR lies in a 4 MB page, the PDE that maps it is returned
+   instead, whose flags have the same meaning, or a null pointer
+   if CREATE is true. */
 static uint32_t *
 lookup_page (uint32_t *pd, const void *vaddr, bool create)
 {
@@ -79,6 +84,8 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
       else
         return NULL;
     }
+  else if (*pde & PTE_PS)
+    return create ? NULL : pde;
 
   /* Return the page table entry. */
   pt = pde_get_pt (*pde);
@@ -130,12 +137,48 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
   ASSERT (is_user_vaddr (uaddr));
   
   pte = lookup_page (pd, uaddr, false);
+  if (pte != NULL && (*pte & PTE_P) != 0 && (*pte & PTE_PS) != 0)
+    return pde_get_page (*pte) + ((uintptr_t) uaddr & (PTSPAN - 1));
   if (pte != NULL && (*pte & PTE_P) != 0)
     return pte_get_page (*pte) + pg_ofs (uaddr);
   else
     return NULL;
 }
 
+/* Maps the 4 MB user virtual page UPAGE in page directory PD
+   to the 4 MB page at kernel virtual address KPAGE, which must
+   be physically contiguous and 4 MB aligned, as obtained with
+   palloc_get_large().  The page is freed along with PD.
+   If WRITABLE is true, the page is read/write; otherwise it is
+   read-only.
+   Returns false if 4 MB pages are not enabled or if anything is
+   mapped in the 4 MB at UPAGE already. */
+bool
+pagedir_set_large_page (uint32_t *pd, void *upage, void *kpage,
+                        bool writable) 
+{
+  uint32_t *pde;
+
+  ASSERT (((uintptr_t) upage & (PTSPAN - 1)) == 0);
+  ASSERT (is_user_vaddr ((uint8_t *) upage + PTSPAN - 1));
+  ASSERT (pd != base_page_dir);
+
+  pde = pd + pd_no (upage);
+  if (!pse_enabled || *pde != 0)
+    return false;
+  *pde = pde_create_large (kpage, writable, true);
+  return true;
+}
+
+/* Returns true if user virtual address VADDR lies in a 4 MB page
+   in PD. */
+bool
+pagedir_is_large (uint32_t *pd, const void *vaddr) 
+{
+  ASSERT (is_user_vaddr (vaddr));
+  return (pd[pd_no (vaddr)] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS);
+}
+
 /* Marks user virtual page UPAGE "not present" in page
    directory PD.  Later accesses to the page will fault.  Other
    bits in the page table entry are preserved.
@@ -12,17 +12,25 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "vm/frame.h"
 #include "vm/page.h"
 
+/* Longest command line process_execute() accepts, including the
+   null terminator. */
+#define CMDLINE_MAX (16 * PGSIZE)
+
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static bool spawn_attach (struct spawn_start *);
 extern int process_num = 1;
 
 
@@ -38,14 +46,19 @@ process_execute (const char *file_name)
   FTE *fte_temp;
   char * real_file, *save_ptr;
   tid_t tid  = 0;
+  size_t len, pg_cnt;
   
-  /* Make a copy of FILE_NAME.
+  /* Make a copy of FILE_NAME, in as many pages as it needs.
      Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
+  len = strnlen (file_name, CMDLINE_MAX);
+  if (len == CMDLINE_MAX)
+    return TID_ERROR;
+  pg_cnt = DIV_ROUND_UP (len + 1, PGSIZE);
+  fn_copy = palloc_get_multiple (0, pg_cnt);
 
   if (fn_copy == NULL)
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
+  memcpy (fn_copy, file_name, len + 1);
   
   
   
@@ -56,7 +69,7 @@ process_execute (const char *file_name)
   if(thread_current()->tid == 1) sema_down(&thread_current()->main_sema);
   sema_down(&child->sema);
   if (tid == TID_ERROR){
-    palloc_free_page (fn_copy);    
+    palloc_free_multiple (fn_copy, pg_cnt);    
   }
 
   
@@ -77,6 +90,7 @@ start_process (void *f_name)
   char *file_name = f_name;
   struct intr_frame if_;
   bool success;
+  bool attached = true;
   char* save_ptr;
   // struct thread* parent = thread_current()->parent;
   
@@ -87,12 +101,19 @@ start_process (void *f_name)
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
+  if (thread_current ()->parent->spawn_start != NULL)
+    attached = spawn_attach (thread_current ()->parent->spawn_start);
   success = load (file_name, &if_.eip, &if_.esp);
   // printf("load complete %d\n", success);
     
   // printf("SUCCESS : %d\n", success);
   /* If load failed, quit. */
-  palloc_free_page (file_name);
+  palloc_free_multiple (file_name, DIV_ROUND_UP (strlen (file_name) + 1, PGSIZE));
+
+  /* A spawned child missing some of its files must not run; its
+     parent reports the spawn as failed. */
+  if (!attached)
+    syscall_exit (-1);
 
   /* Start the user process by simulating a return from an
      interrupt, implemented by intr_exit (in
@@ -120,6 +141,11 @@ process_wait (tid_t child_tid UNUSED)
   struct list_elem *e; 
   int flag = 0;
   struct list_elem *child;
+  int status;
+
+  /* A spawned child is waited for by process_wait_any(). */
+  if (process_wait_any (&child_tid, 1, &status) != TID_ERROR)
+    return status;
 
   // printf("CHILD NUM : %d\n", thread_current()->child_num );
   if(thread_current()->child_num == 0 && process_num != 2){
@@ -181,6 +207,308 @@ process_wait (tid_t child_tid UNUSED)
   return parent->exit_status;
 }
 
+/* Process batches.  A child started by process_spawn() gets only
+   the files its parent maps into it, and can be waited for along
+   with its siblings by process_wait_any() and process_wait_all(),
+   so a parent running many children need not wait for them one
+   at a time in the order it started them. */
+
+/* A child started by process_spawn(), as its parent sees it.
+   Shared by parent and child, and freed by whichever of the two
+   lets go of it last. */
+struct spawn_child
+  {
+    struct list_elem elem;      /* Element in parent's spawn_list. */
+    struct thread *parent;      /* Parent, or null once it is done. */
+    tid_t tid;                  /* Child's thread id. */
+    int status;                 /* Exit status, once exited. */
+    bool exited;                /* Has the child exited? */
+    int ref_cnt;                /* Parent and child references. */
+  };
+
+/* What a spawned child picks up from its parent as it starts.
+   Lives on the parent's stack; the parent waits for the child to
+   load before returning, which is long enough. */
+struct spawn_start
+  {
+    struct spawn_child *child;  /* The child's entry. */
+    const struct spawn_fd *fds; /* Files to map into the child. */
+    int fd_cnt;                 /* Number of FDS. */
+    bool ok;                    /* Set by the child: all FDS opened? */
+  };
+
+/* Guards every spawn_child and spawn_list. */
+static struct lock spawn_lock;
+
+/* Returns the file T has open as FD, or a null pointer. */
+static struct file_info *
+process_file (struct thread *t, int fd)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&openfile_list); e != list_end (&openfile_list);
+       e = list_next (e))
+    {
+      struct file_info *of = list_entry (e, struct file_info, elem);
+      if (of->fd == fd && of->opener == t->tid)
+        return of;
+    }
+  return NULL;
+}
+
+/* Drops a reference to CHILD, freeing it if that was the last.
+   Must be called with spawn_lock held. */
+static void
+spawn_release (struct spawn_child *child)
+{
+  if (--child->ref_cnt == 0)
+    free (child);
+}
+
+/* Removes CHILD from its parent's spawn_list and drops the
+   parent's reference.  Must be called with spawn_lock held. */
+static void
+spawn_reap (struct spawn_child *child)
+{
+  list_remove (&child->elem);
+  child->parent = NULL;
+  spawn_release (child);
+}
+
+/* Returns the child of T with the given TID that was started by
+   process_spawn() and not yet waited for, or a null pointer.
+   Must be called with spawn_lock held. */
+static struct spawn_child *
+spawn_find (struct thread *t, tid_t tid)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&t->spawn_list); e != list_end (&t->spawn_list);
+       e = list_next (e))
+    {
+      struct spawn_child *child = list_entry (e, struct spawn_child, elem);
+      if (child->tid == tid)
+        return child;
+    }
+  return NULL;
+}
+
+/* Called by a spawned child as it starts: takes a reference to
+   its entry in START and opens the files START maps into it.
+   Returns false, also recorded in START, if any of them could
+   not be opened. */
+static bool
+spawn_attach (struct spawn_start *start)
+{
+  struct thread *cur = thread_current ();
+  int i;
+
+  lock_acquire (&spawn_lock);
+  start->child->ref_cnt++;
+  cur->spawn = start->child;
+  lock_release (&spawn_lock);
+
+  for (i = 0; i < start->fd_cnt; i++)
+    {
+      struct file_info *pf = process_file (cur->parent, start->fds[i].parent_fd);
+      struct file_info *of;
+
+      of = malloc (sizeof *of);
+      if (of == NULL)
+        break;
+      of->file = file_reopen (pf->file);
+      if (of->file == NULL)
+        {
+          free (of);
+          break;
+        }
+      file_seek (of->file, file_tell (pf->file));
+      of->dir = NULL;
+      if (pf->dir != NULL)
+        {
+          of->dir = dir_open (inode_reopen (file_get_inode (of->file)));
+          if (of->dir == NULL)
+            {
+              file_close (of->file);
+              free (of);
+              break;
+            }
+        }
+      of->fd = start->fds[i].child_fd;
+      of->opener = cur->tid;
+      of->deny_flag = pf->deny_flag;
+      sema_init (&of->file_sema, 1);
+      list_push_front (&openfile_list, &of->elem);
+    }
+  start->ok = i == start->fd_cnt;
+  return start->ok;
+}
+
+/* Called by a spawned process as it exits: hands its exit status
+   to its parent, if the parent is still there. */
+static void
+spawn_exit (void)
+{
+  struct thread *cur = thread_current ();
+  struct spawn_child *child = cur->spawn;
+
+  lock_acquire (&spawn_lock);
+  child->status = cur->exit_status;
+  child->exited = true;
+  if (child->parent != NULL)
+    cond_signal (&child->parent->spawn_cond, &spawn_lock);
+  spawn_release (child);
+  cur->spawn = NULL;
+  lock_release (&spawn_lock);
+}
+
+/* Starts a new process running CMD_LINE, like process_execute(),
+   with the FD_CNT files in FDS open in it.  Each entry of FDS
+   names a file the running process has open and the descriptor
+   it gets in the child.  The child may be waited for with
+   process_wait(), process_wait_any() or process_wait_all().
+   Returns the new process's tid, or TID_ERROR if FDS is bad, the
+   child could not open all of FDS, or the process cannot be
+   started. */
+tid_t
+process_spawn (const char *cmd_line, const struct spawn_fd *fds, int fd_cnt)
+{
+  struct thread *cur = thread_current ();
+  struct spawn_start start;
+  struct spawn_child *child;
+  tid_t tid;
+  int i, j;
+
+  for (i = 0; i < fd_cnt; i++)
+    {
+      if (fds[i].child_fd <= STDERR
+          || process_file (cur, fds[i].parent_fd) == NULL)
+        return TID_ERROR;
+      for (j = 0; j < i; j++)
+        if (fds[j].child_fd == fds[i].child_fd)
+          return TID_ERROR;
+    }
+
+  child = malloc (sizeof *child);
+  if (child == NULL)
+    return TID_ERROR;
+  child->parent = cur;
+  child->tid = TID_ERROR;
+  child->status = -1;
+  child->exited = false;
+  child->ref_cnt = 1;
+
+  start.child = child;
+  start.fds = fds;
+  start.fd_cnt = fd_cnt;
+  start.ok = false;
+  cur->spawn_start = &start;
+  tid = process_execute (cmd_line);
+  cur->spawn_start = NULL;
+
+  /* The child has attached by now if it started at all; one that
+     failed to exits on its own. */
+  if (!start.ok)
+    tid = TID_ERROR;
+
+  lock_acquire (&spawn_lock);
+  if (tid != TID_ERROR)
+    {
+      child->tid = tid;
+      list_push_back (&cur->spawn_list, &child->elem);
+    }
+  else
+    {
+      child->parent = NULL;
+      spawn_release (child);
+    }
+  lock_release (&spawn_lock);
+  return tid;
+}
+
+/* Waits for any one of the CNT processes in TIDS to exit, stores
+   its exit status in *STATUS and returns its tid.  Each of TIDS
+   must be a child started by process_spawn() that has not been
+   waited for; if one is not, returns TID_ERROR without waiting.
+   A child that has already exited is returned at once. */
+tid_t
+process_wait_any (const tid_t *tids, int cnt, int *status)
+{
+  struct thread *cur = thread_current ();
+  tid_t tid = TID_ERROR;
+  int i;
+
+  lock_acquire (&spawn_lock);
+  for (;;)
+    {
+      struct spawn_child *done = NULL;
+
+      for (i = 0; i < cnt; i++)
+        {
+          struct spawn_child *child = spawn_find (cur, tids[i]);
+          if (child == NULL)
+            goto out;
+          if (done == NULL && child->exited)
+            done = child;
+        }
+      if (done != NULL)
+        {
+          *status = done->status;
+          tid = done->tid;
+          spawn_reap (done);
+          break;
+        }
+      cond_wait (&cur->spawn_cond, &spawn_lock);
+    }
+ out:
+  lock_release (&spawn_lock);
+  return tid;
+}
+
+/* Waits for all of the CNT processes in TIDS to exit and stores
+   their exit statuses in STATUS[], in the same order.  Each of
+   TIDS must be a child started by process_spawn() that has not
+   been waited for; if one is not, returns false without waiting.
+   Returns true otherwise. */
+bool
+process_wait_all (const tid_t *tids, int cnt, int *status)
+{
+  struct thread *cur = thread_current ();
+  bool all_exited;
+  int i;
+
+  lock_acquire (&spawn_lock);
+  do
+    {
+      all_exited = true;
+      for (i = 0; i < cnt; i++)
+        {
+          struct spawn_child *child = spawn_find (cur, tids[i]);
+          if (child == NULL)
+            {
+              lock_release (&spawn_lock);
+              return false;
+            }
+          if (!child->exited)
+            all_exited = false;
+          status[i] = child->status;
+        }
+      if (!all_exited)
+        cond_wait (&cur->spawn_cond, &spawn_lock);
+    }
+  while (!all_exited);
+
+  /* A tid given twice is reaped once. */
+  for (i = 0; i < cnt; i++)
+    {
+      struct spawn_child *child = spawn_find (cur, tids[i]);
+      if (child != NULL)
+        spawn_reap (child);
+    }
+  lock_release (&spawn_lock);
+  return true;
+}
+
 /* Free the current process's resources. */
 void
 process_exit (void)
@@ -238,11 +566,23 @@ process_exit (void)
 
     
   
+  /* Let go of spawned children still running. */
+  lock_acquire (&spawn_lock);
+  while (!list_empty (&curr->spawn_list))
+    spawn_reap (list_entry (list_front (&curr->spawn_list),
+                            struct spawn_child, elem));
+  lock_release (&spawn_lock);
+  
   free(thread_current()->exec);
   file_close(thread_current()->file);
-  curr->parent->exit_status = thread_current()->exit_status;
-  if(parent->tid==1) sema_up(&parent->main_sema);
-  sema_up(&parent->sema);
+  if (curr->spawn != NULL)
+    spawn_exit ();
+  else
+    {
+      curr->parent->exit_status = thread_current()->exit_status;
+      if(parent->tid==1) sema_up(&parent->main_sema);
+      sema_up(&parent->sema);
+    }
 
   thread_exit(); 
 }
@@ -332,6 +672,256 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
+/* Exec cache.  Programs are often run many times in a row, so
+   the result of reading and validating an executable's headers
+   is kept, keyed by inode, and a later exec of the same file
+   only has to build the address space from it.  An entry holds
+   its inode open and is dropped once the inode has been written
+   to or removed since the entry was made. */
+#define EXEC_CACHE_SIZE 8       /* Most executables cached. */
+
+/* A PT_LOAD segment, as passed to load_segment(). */
+struct exec_segment
+  {
+    uint32_t file_page;         /* Page-aligned file offset. */
+    uint32_t mem_page;          /* Page-aligned user address. */
+    uint32_t read_bytes;        /* Bytes to read from the file. */
+    uint32_t zero_bytes;        /* Bytes to zero after those. */
+    bool writable;              /* Writable by the user? */
+  };
+
+/* A validated executable. */
+struct exec_image
+  {
+    struct list_elem elem;      /* Element in exec_cache. */
+    struct inode *inode;        /* Executable, held open. */
+    unsigned write_gen;         /* inode_write_gen() when parsed. */
+    int ref_cnt;                /* The cache's and loaders' references. */
+    Elf32_Addr entry;           /* Entry point. */
+    int seg_cnt;                /* Number of segments. */
+    struct exec_segment *segs;  /* Loadable segments. */
+  };
+
+static struct list exec_cache;  /* Most recently used first. */
+static int exec_cache_cnt;      /* Entries in exec_cache. */
+static struct lock exec_cache_lock;
+
+static struct exec_image *exec_parse (struct file *, const char *file_name);
+static void exec_image_free (struct exec_image *);
+static void exec_image_unref (struct exec_image *);
+
+/* Initializes the exec cache and process batches. */
+void
+process_init (void)
+{
+  list_init (&exec_cache);
+  lock_init (&exec_cache_lock);
+  lock_init (&spawn_lock);
+}
+
+/* Discards every stale entry, closing its inode, so that a
+   removed executable does not stay allocated on disk.  Must be
+   called with exec_cache_lock held. */
+static void
+exec_cache_sweep (void)
+{
+  struct list_elem *e, *next;
+
+  for (e = list_begin (&exec_cache); e != list_end (&exec_cache); e = next)
+    {
+      struct exec_image *img = list_entry (e, struct exec_image, elem);
+      next = list_next (e);
+      if (img->write_gen != inode_write_gen (img->inode))
+        {
+          list_remove (e);
+          exec_cache_cnt--;
+          exec_image_unref (img);
+        }
+    }
+}
+
+/* Discards the entries of the exec cache for executables that
+   have been written to or removed.  Called after a file is
+   removed. */
+void
+process_cache_sweep (void)
+{
+  lock_acquire (&exec_cache_lock);
+  exec_cache_sweep ();
+  lock_release (&exec_cache_lock);
+}
+
+/* Returns the cached image of INODE, moved to the front of the
+   cache, or a null pointer if there is none.  Stale entries are
+   discarded first.  Must be called with exec_cache_lock held. */
+static struct exec_image *
+exec_cache_lookup (struct inode *inode)
+{
+  struct list_elem *e;
+
+  exec_cache_sweep ();
+  for (e = list_begin (&exec_cache); e != list_end (&exec_cache);
+       e = list_next (e))
+    {
+      struct exec_image *img = list_entry (e, struct exec_image, elem);
+      if (img->inode == inode)
+        {
+          list_remove (e);
+          list_push_front (&exec_cache, e);
+          return img;
+        }
+    }
+  return NULL;
+}
+
+/* Adds IMG, which the caller holds a reference to, to the front
+   of the cache, evicting the least recently used entry if the
+   cache is full, and returns it.  If another thread has cached
+   the same executable meanwhile, IMG is dropped instead and that
+   image is returned, with a reference for the caller.  Must be
+   called with exec_cache_lock held. */
+static struct exec_image *
+exec_cache_insert (struct exec_image *img)
+{
+  struct exec_image *cached = exec_cache_lookup (img->inode);
+
+  if (cached != NULL)
+    {
+      exec_image_unref (img);
+      cached->ref_cnt++;
+      return cached;
+    }
+
+  img->ref_cnt++;
+  list_push_front (&exec_cache, &img->elem);
+  if (++exec_cache_cnt > EXEC_CACHE_SIZE)
+    {
+      struct list_elem *e = list_pop_back (&exec_cache);
+      exec_cache_cnt--;
+      exec_image_unref (list_entry (e, struct exec_image, elem));
+    }
+  return img;
+}
+
+/* Drops a reference to IMG, freeing it with the last one.  Must
+   be called with exec_cache_lock held if IMG has been cached. */
+static void
+exec_image_unref (struct exec_image *img)
+{
+  if (--img->ref_cnt == 0)
+    exec_image_free (img);
+}
+
+/* Frees IMG, which must not be in the cache. */
+static void
+exec_image_free (struct exec_image *img)
+{
+  inode_close (img->inode);
+  free (img->segs);
+  free (img);
+}
+
+/* Reads and validates the headers of executable FILE and returns
+   them as a new image, with a reference for the caller, or a null
+   pointer on failure. */
+static struct exec_image *
+exec_parse (struct file *file, const char *file_name)
+{
+  struct Elf32_Ehdr ehdr;
+  struct exec_image *img;
+  off_t file_ofs;
+  int i;
+
+  /* Read and verify executable header. */
+  if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+      || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
+      || ehdr.e_type != 2
+      || ehdr.e_machine != 3
+      || ehdr.e_version != 1
+      || ehdr.e_phentsize != sizeof (struct Elf32_Phdr)
+      || ehdr.e_phnum > 1024)
+    {
+      printf ("load: %s: error loading executable\n", file_name);
+      return NULL;
+    }
+
+  img = malloc (sizeof *img);
+  if (img == NULL)
+    return NULL;
+  img->segs = malloc (ehdr.e_phnum * sizeof *img->segs);
+  if (img->segs == NULL)
+    {
+      free (img);
+      return NULL;
+    }
+  img->inode = inode_reopen (file_get_inode (file));
+  img->write_gen = inode_write_gen (img->inode);
+  img->ref_cnt = 1;
+  img->entry = ehdr.e_entry;
+  img->seg_cnt = 0;
+
+  /* Read program headers. */
+  file_ofs = ehdr.e_phoff;
+  for (i = 0; i < ehdr.e_phnum; i++)
+    {
+      struct Elf32_Phdr phdr;
+      struct exec_segment *seg;
+      uint32_t page_offset;
+
+      if (file_ofs < 0 || file_ofs > file_length (file))
+        goto fail;
+      file_seek (file, file_ofs);
+
+      if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
+        goto fail;
+      file_ofs += sizeof phdr;
+      switch (phdr.p_type)
+        {
+        case PT_NULL:
+        case PT_NOTE:
+        case PT_PHDR:
+        case PT_STACK:
+        default:
+          /* Ignore this segment. */
+          break;
+        case PT_DYNAMIC:
+        case PT_INTERP:
+        case PT_SHLIB:
+          goto fail;
+        case PT_LOAD:
+          if (!validate_segment (&phdr, file))
+            goto fail;
+
+          seg = &img->segs[img->seg_cnt++];
+          seg->writable = (phdr.p_flags & PF_W) != 0;
+          seg->file_page = phdr.p_offset & ~PGMASK;
+          seg->mem_page = phdr.p_vaddr & ~PGMASK;
+          page_offset = phdr.p_vaddr & PGMASK;
+          if (phdr.p_filesz > 0)
+            {
+              /* Normal segment.
+                 Read initial part from disk and zero the rest. */
+              seg->read_bytes = page_offset + phdr.p_filesz;
+              seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
+                                 - seg->read_bytes);
+            }
+          else
+            {
+              /* Entirely zero.
+                 Don't read anything from disk. */
+              seg->read_bytes = 0;
+              seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+            }
+          break;
+        }
+    }
+  return img;
+
+ fail:
+  exec_image_free (img);
+  return NULL;
+}
+
 /* Loads an ELF executable from FILE_NAME into the current thread.
    Stores the executable's entry point into *EIP
    and its initial stack pointer into *ESP.
@@ -342,10 +932,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
   struct thread *t = thread_current ();
   struct thread * parent = thread_current()->parent;
-  struct Elf32_Ehdr ehdr;
+  struct exec_image *img;
+  Elf32_Addr entry;
   struct file *file = NULL;
-  off_t file_ofs;
   bool success = false;
+  bool loaded;
   int i;
   char *fn_copy;
   char *real_file, *save_ptr;
@@ -382,99 +973,48 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
   thread_current()->file = file;
 
-  /* Read and verify executable header. */
-  if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
-      || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
-      || ehdr.e_type != 2
-      || ehdr.e_machine != 3
-      || ehdr.e_version != 1
-      || ehdr.e_phentsize != sizeof (struct Elf32_Phdr)
-      || ehdr.e_phnum > 1024) 
+  /* Find the executable's headers, reading them on a miss.  The
+     lock is only held to take a reference to the image, which
+     keeps it alive while the address space is built from it. */
+  lock_acquire (&exec_cache_lock);
+  img = exec_cache_lookup (file_get_inode (file));
+  if (img != NULL)
+    img->ref_cnt++;
+  lock_release (&exec_cache_lock);
+  if (img == NULL)
     {
-      printf ("load: %s: error loading executable\n", file_name);
-      goto done; 
+      img = exec_parse (file, file_name);
+      if (img == NULL)
+        goto done;
+      lock_acquire (&exec_cache_lock);
+      img = exec_cache_insert (img);
+      lock_release (&exec_cache_lock);
     }
 
-
-
-  /* Read program headers. */
-
-   
-  file_ofs = ehdr.e_phoff;
-
-  for (i = 0; i < ehdr.e_phnum; i++) 
+  /* Describe each segment; pages are loaded as they fault. */
+  for (i = 0; i < img->seg_cnt; i++)
     {
-      struct Elf32_Phdr phdr;
-
-      if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
-      file_seek (file, file_ofs);
-
-      if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-
-        goto done;
-      file_ofs += sizeof phdr;
-      switch (phdr.p_type) 
-        {
-        case PT_NULL:
-        case PT_NOTE:
-        case PT_PHDR:
-        case PT_STACK:
-        default:
-          /* Ignore this segment. */
-          break;
-        case PT_DYNAMIC:
-        case PT_INTERP:
-        case PT_SHLIB:
-          goto done;
-        case PT_LOAD:
-          if (validate_segment (&phdr, file)) 
-            {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
-              uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
-              if (phdr.p_filesz > 0)
-                {
-                  /* Normal segment.
-                     Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
-                }
-              else 
-                {
-                  /* Entirely zero.
-                     Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
-                }
-
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-
-                goto done;
-
-            }
-          else{
-
-            goto done;
-          }
-          break;
-        }
+      struct exec_segment *seg = &img->segs[i];
+      if (!load_segment (file, seg->file_page, (void *) seg->mem_page,
+                         seg->read_bytes, seg->zero_bytes, seg->writable))
+        break;
     }
+  loaded = i == img->seg_cnt;
+  entry = img->entry;
 
+  lock_acquire (&exec_cache_lock);
+  exec_image_unref (img);
+  lock_release (&exec_cache_lock);
+  if (!loaded)
+    goto done;
 
-
-  
   /* Set up stack. */
   if (!setup_stack (esp, file_name))
     goto done;
 
 
   /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+  *eip = (void (*) (void)) entry;
   success = true;
   
   if(success){
@@ -567,167 +1107,95 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
-  file_seek (file, ofs);
-  // printf("LOAD SEGMENT\n");
-  while (read_bytes > 0 || zero_bytes > 0) 
-    {
-      /* Do calculate how to fill this page.
-         We will read PAGE_READ_BYTES bytes from FILE
-         and zero the final PAGE_ZERO_BYTES bytes. */
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-      /* Get a page of memory. */
-      if(!lazy_load(upage, file, ofs, page_read_bytes, page_zero_bytes, writable))
-        return false;
-
-      // uint8_t *kpage = frame_get_fte(upage, PAL_USER|PAL_ZERO);
-      // // printf("UPAGE: %p KPAGE : %p\n", upage,kpage);
-
-      // if(kpage == NULL)
-      // {
-      //   // printf("fifo occur proc(551) for tid(%d)\n", thread_current()->tid);
-      //   FTE *fte = frame_fifo_fte();
-      //   // printf("UADDR : %x\n", fte->uaddr);
-      //   if(fte != NULL)
-      //     swap_out(fte->uaddr);
-      //   // printf("swap out pass\n");
-      //   kpage = frame_get_fte(upage, PAL_USER | PAL_ZERO);
-      //   ASSERT(kpage != NULL);
-      //   // printf("KPAGE : %x\n", kpage);
-      // }
-
-      
-      // if(kpage == NULL)
-      //   return false;
-      // /* Load this page. */
-      // // printf("UPAGE : %x\n", upage);  
-      // if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
-      //   {
-      //     frame_remove_fte(kpage);
-      //     page_remove_pte(upage);
-      //     return false; 
-      //   }
-      // memset (kpage + page_read_bytes, 0, page_zero_bytes);
-
-      // /* Add the page to the process's address space. */
-      // if (!install_page (upage, kpage, writable)) 
-      //   {
-      //     frame_remove_fte(kpage);
-      //     page_remove_pte(upage);
-      //     return false; 
-      //   }
-      //   page_map(upage, kpage, writable);
-      //   PTE * temp = page_pte_lookup(pg_round_down(upage));
-      //   temp->load = true;
-
-      /* Advance. */
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      upage += PGSIZE;
-      ofs += page_read_bytes;
-    }
-  // printf("EXIT WHILE, TID : %d\n",thread_current()->tid);
+
+  /* The whole segment is described once; its pages are set up
+     as they are faulted in. */
+  if (!page_add_vma (upage, file, ofs, read_bytes, zero_bytes, writable, false))
+    return false;
 
   return true;
 }
 
-/* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+/* Create the user stack at the top of user virtual memory and
+   push the words of command line FILE_NAME onto it as argv[].
+
+   This takes one pass over FILE_NAME, from its end, copying each
+   word straight to its final place: the strings grow down from
+   PHYS_BASE, and argv[] grows down in step from just below the
+   room FILE_NAME could take, so argv[i] is stored as soon as
+   word i is found.  The stack gets as many pages as the longest
+   possible layout needs. */
 static bool
-setup_stack (void **esp, char *file_name) 
+setup_stack (void **esp, char *file_name)
 {
   uint8_t *kpage;
-  bool success = false;
-  kpage = frame_get_fte(((uint8_t *) PHYS_BASE) - PGSIZE, PAL_USER | PAL_ZERO);
+  size_t len = strlen (file_name);
+  size_t size;
+  int pg_cnt, argc, i;
+  uint8_t *str;
+  char **argv;
+  void **sp;
+
+  /* Strings, with one null per word, fit in LEN + 1 bytes, and
+     there are at most half that many words. */
+  size = ROUND_UP (len + 1, sizeof (char *))
+         + ((len + 1) / 2 + 1) * sizeof (char *) + 3 * sizeof (void *);
+  pg_cnt = DIV_ROUND_UP (size, PGSIZE);
+  if ((size_t) pg_cnt * PGSIZE > (size_t) STACK_MAX)
+    return false;
+
+  kpage = frame_alloc(((uint8_t *) PHYS_BASE) - PGSIZE, PAL_USER | PAL_ZERO);
   // printf("KPAGE : %x\n", kpage);
   if(kpage == NULL)
-  {
-    // printf("fifo occur proc(606)\n");
-    FTE *fte = frame_fifo_fte();
-    if(fte != NULL)
-      swap_out(fte->uaddr);
-    kpage = frame_get_fte(((uint8_t *) PHYS_BASE) - PGSIZE, PAL_USER | PAL_ZERO);
-    ASSERT(kpage != NULL);
-  }
-  
-  // kpage = palloc_get_page ();
-
+    return false;
 
-  if (kpage != NULL) 
+  if (!install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true))
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success){
-        *esp = PHYS_BASE - 12;
-        page_map(((uint8_t *) PHYS_BASE) - PGSIZE, kpage, false);
-      }
-      else
-      {
-        frame_remove_fte(kpage);
-        page_remove_pte(((uint8_t *) PHYS_BASE) - PGSIZE);
-      }
+      frame_remove_fte(kpage);
+      page_remove_pte(((uint8_t *) PHYS_BASE) - PGSIZE);
+      return false;
     }
+  page_map(((uint8_t *) PHYS_BASE) - PGSIZE, kpage, false);
 
-  char *token = NULL;
-  char *save_ptr = NULL;
-  int argc = 0;
-  int i = 0;
-  
-
-  char * copy = malloc(strlen(file_name)+1);
-  strlcpy (copy, file_name, strlen(file_name)+1);
-
-
-  for (token = strtok_r (copy, " ", &save_ptr); token != NULL;
-    token = strtok_r (NULL, " ", &save_ptr)){
-    argc++;
-  }
-
-  int *argv = calloc(argc,sizeof(uint32_t));
-  i=0;
-  for(token = strtok_r(file_name, " ", &save_ptr); token != NULL;
-    token = strtok_r(NULL, " ", &save_ptr))
-  {
-    *esp -= strlen(token) + 1;
-    memcpy(*esp, token, strlen(token) + 1);
-    argv[i]=*esp;
-    i++;
-  }
-
+  /* A long command line spills onto further pages. */
+  for (i = 2; i <= pg_cnt; i++)
+    if (stack_growth ((uint32_t *) ((uint8_t *) PHYS_BASE - i * PGSIZE)) == NULL)
+      return false;
 
-  uint32_t padding = 0;
+  str = PHYS_BASE;
+  argv = (char **) ROUND_DOWN ((uintptr_t) PHYS_BASE - (len + 1),
+                               sizeof (char *)) - 1;
+  *argv = NULL;
 
-  while((int)*esp % 4 != 0)
-  {
-    *esp -= 1;
-    memcpy(*esp, &padding, 1);
-  }
-
-  *esp -= 4;
-  memcpy(*esp, &padding, 4);
-
-  
-
-  for(i = argc; i > 0; i--)
-  {
-    *esp -= 4;
-    memcpy(*esp, &argv[i-1], 4);
-  }
-  
-
-  uint32_t self = *esp;
+  argc = 0;
+  i = len;
+  for (;;)
+    {
+      int end;
 
-  *esp -= 4;
-  memcpy(*esp, &self, 4);
-  *esp -= 4;
-  memcpy(*esp, &argc, 4);
-  *esp -= 4;
-  memcpy(*esp, &padding, 4);
+      while (i > 0 && file_name[i - 1] == ' ')
+        i--;
+      if (i == 0)
+        break;
+      end = i;
+      while (i > 0 && file_name[i - 1] != ' ')
+        i--;
+
+      str -= end - i + 1;
+      memcpy (str, file_name + i, end - i);
+      str[end - i] = '\0';
+      *--argv = (char *) str;
+      argc++;
+    }
 
-  free(argv);
-  free(copy);
+  /* argv, argc, and a fake return address. */
+  sp = (void **) argv;
+  *--sp = argv;
+  *--sp = (void *) argc;
+  *--sp = NULL;
+  *esp = sp;
 
-  return success;
+  return true;
 }
 
 void* stack_growth(uint32_t *esp)
@@ -736,17 +1204,10 @@ void* stack_growth(uint32_t *esp)
   uint32_t *resp = pg_round_down(esp);
 
   /* find a frame for one additional stack */
-  kpage = frame_get_fte(resp, PAL_USER | PAL_ZERO);
+  kpage = frame_alloc(resp, PAL_USER | PAL_ZERO);
 
   if(kpage == NULL)
-  {
-    // printf("fifo occur proc(702)\n");
-    FTE *fte = frame_fifo_fte();
-    if(fte != NULL)
-      swap_out(fte->uaddr);
-    kpage = frame_get_fte(resp, PAL_USER | PAL_ZERO);
-    ASSERT(kpage != NULL);
-  }
+    return NULL;
 
   
   // printf("resp : %x , kpage : %x\n", resp, kpage);
@@ -5,6 +5,7 @@
 #include "userprog/exception.h"
 #include <stdbool.h>
 #include "filesys/directory.h"
+#include <spawn.h>
 
 
 #define STDIN 0   /* Standard input. */
@@ -24,8 +25,13 @@ struct file_info{
 struct list openfile_list;
 
 
+void process_init (void);
+void process_cache_sweep (void);
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
+tid_t process_spawn (const char *cmd_line, const struct spawn_fd *, int fd_cnt);
+tid_t process_wait_any (const tid_t *tids, int cnt, int *status);
+bool process_wait_all (const tid_t *tids, int cnt, int *status);
 void process_exit (void);
 void process_activate (void);
 void process_exit (void);
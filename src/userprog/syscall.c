@@ -10,10 +10,12 @@
 #include "filesys/file.h"
 #include "userprog/exception.h"
 #include "vm/page.h"
+#include "vm/frame.h"
 #include <string.h>
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "threads/synch.h"
+#include "threads/malloc.h"
 
 int dir_num = 0;
 static void syscall_handler (struct intr_frame *);
@@ -145,7 +147,7 @@ static void syscall_handler (struct intr_frame *f UNUSED)
    if(pagedir_get_page(thread_current()->pagedir, *(p+2))==NULL)
      {
 
-        PTE* result = page_pte_lookup(pg_round_down(*(p+2)));
+        PTE* result = page_pte_get(pg_round_down(*(p+2)));
 
         if(result != NULL)
           goto N;
@@ -183,7 +185,7 @@ static void syscall_handler (struct intr_frame *f UNUSED)
      case SYS_WRITE:   /* 9 */
      if(pagedir_get_page(thread_current()->pagedir, *(p+7))==NULL)
      {
-        PTE* result = page_pte_lookup(pg_round_down(*(p+7)));
+        PTE* result = page_pte_get(pg_round_down(*(p+7)));
 
         if(result != NULL)
           goto writeyame;
@@ -237,6 +239,31 @@ static void syscall_handler (struct intr_frame *f UNUSED)
      f->eax = syscall_inumber(*(p+1));
      break;
 
+     case SYS_VMSTAT:
+     f->eax = syscall_vmstat((struct vmstat *) *(p+1));
+     break;
+
+     case SYS_RSSLIMIT:
+     f->eax = syscall_rsslimit(*(p+1));
+     break;
+
+     case SYS_MAPLARGE:
+     f->eax = syscall_map_large((void *) *(p+1));
+     break;
+
+     case SYS_SPAWN:
+     f->eax = syscall_spawn((const char *) *(p+1),
+                            (const struct spawn_fd *) *(p+2), *(p+3));
+     break;
+
+     case SYS_WAIT_ANY:
+     f->eax = syscall_wait_any((const pid_t *) *(p+1), *(p+2), (int *) *(p+3));
+     break;
+
+     case SYS_WAIT_ALL:
+     f->eax = syscall_wait_all((const pid_t *) *(p+1), *(p+2), (int *) *(p+3));
+     break;
+
      default:
      // printf("ERROR at syscall_handler\n");
      break;
@@ -266,6 +293,18 @@ void syscall_exit(int status)
    process_exit();
 }
 
+/* Returns true if the running process has a file open as FD. */
+static bool fd_in_use(int fd)
+{
+   struct list_elem *e = list_begin(&openfile_list);
+   for(; e != list_end(&openfile_list); e = list_next(e)){
+      struct file_info *of = list_entry(e, struct file_info, elem);
+      if(of->fd == fd && of->opener == thread_current()->tid)
+         return true;
+   }
+   return false;
+}
+
 int syscall_open(const char * file)
 {
    int fd;
@@ -296,6 +335,8 @@ int syscall_open(const char * file)
    else{
       
       fd = list_size(&openfile_list) + 3;
+      while(fd_in_use(fd))
+         fd++;
       // printf("fd : %d\n", fd);
 
       if(new_file->file->inode->data.directory)
@@ -351,7 +392,11 @@ int syscall_wait(pid_t pid)
 
 bool syscall_remove(const char *file)
 {
-   return filesys_remove(file);
+   if(!filesys_remove(file))
+      return false;
+   /* let go of the inode if the exec cache holds it */
+   process_cache_sweep();
+   return true;
 }
 
 int syscall_filesize(int fd)
@@ -361,7 +406,7 @@ int syscall_filesize(int fd)
    for(; e != list_end(&openfile_list); e = list_next(e)){
       of = list_entry(e, struct file_info, elem);
 
-      if(of->fd == fd)
+      if(of->fd == fd && of->opener == thread_current()->tid)
       {
          return file_length(of->file);
       }
@@ -395,7 +440,7 @@ int syscall_read(int fd, void *buffer, unsigned size)
 
       for(; e != list_end(&openfile_list); e = list_next(e)){
          of = list_entry(e, struct file_info, elem);
-         if(of->fd == fd)
+         if(of->fd == fd && of->opener == thread_current()->tid)
          {
             sema_down(&of->file_sema);
             ret_size = file_read(of->file, buffer, size);
@@ -431,7 +476,7 @@ int syscall_write(int fd, const void *buffer, unsigned size)
       // printf("WRITE : %d\n", fd);
       for(; e != list_end(&openfile_list); e = list_next(e)){
          of = list_entry(e, struct file_info, elem);
-         if(of->fd == fd)
+         if(of->fd == fd && of->opener == thread_current()->tid)
          {
             if(of->file->inode->data.directory == true)
               return -1;
@@ -456,7 +501,7 @@ void syscall_seek(int fd, unsigned position)
    
    for(; e != list_end(&openfile_list); e = list_next(e)){
       of = list_entry(e, struct file_info, elem);
-      if(of->fd == fd)
+      if(of->fd == fd && of->opener == thread_current()->tid)
       {
          file_seek(of->file, position);
          break;
@@ -471,7 +516,7 @@ unsigned syscall_tell(int fd)
    
    for(; e != list_end(&openfile_list); e = list_next(e)){
       of = list_entry(e, struct file_info, elem);
-      if(of->fd == fd)
+      if(of->fd == fd && of->opener == thread_current()->tid)
       {
          return file_tell(of->file);
       }
@@ -487,7 +532,7 @@ void syscall_close(int fd)
    // printf("CLOSE FD : %d\n", fd);
    for(; e != list_end(&openfile_list); e = list_next(e)){
       of = list_entry(e, struct file_info, elem);
-      if(of->fd == fd)
+      if(of->fd == fd && of->opener == thread_current()->tid)
       {
          flag = 1;
          break;
@@ -528,7 +573,7 @@ mapid_t syscall_mmap(int fd, void *addr)
   for(; e != list_end(&openfile_list); e = list_next(e))
   {
     fi = list_entry(e, struct file_info, elem);
-    if(fi->fd == fd)
+    if(fi->fd == fd && fi->opener == thread_current()->tid)
     {
       found = true;
       break;
@@ -548,6 +593,8 @@ mapid_t syscall_mmap(int fd, void *addr)
     if(page_pte_lookup(addr + PGSIZE * i) != NULL)
       return -1;
   }
+  if(page_vma_overlaps(addr, addr + PGSIZE * (filelen/PGSIZE + 1)))
+    return -1;
 
   struct mmf *new_mmf = malloc(sizeof(struct mmf));
   new_mmf->file = file_reopen(fi->file);
@@ -556,27 +603,9 @@ mapid_t syscall_mmap(int fd, void *addr)
   new_mmf->filelen = filelen;
   list_push_front(&thread_current()->mmf_list, &new_mmf->elem);
 
-  file_seek(fi->file, 0);
-  for(i = 0; i < filelen/PGSIZE + 1; i++)
-  {
-    uint32_t *upage = addr + PGSIZE * i;
-    uint32_t *kpage = frame_get_fte(upage, PAL_USER | PAL_ZERO);
-    if(kpage == NULL)
-      {
-        FTE *fte = frame_fifo_fte();
-        if(fte != NULL)
-          swap_out(fte->uaddr);
-        kpage = frame_get_fte(upage, PAL_USER | PAL_ZERO);
-        ASSERT(kpage != NULL);
-      }
-    file_read(fi->file, kpage, PGSIZE);
-    
-    page_map(upage, kpage, true);
-    page_pte_lookup(upage)->dirty = true;
-    ASSERT(pagedir_get_page(thread_current()->pagedir, upage) == NULL);
-    ASSERT(pagedir_set_page(thread_current()->pagedir, upage, kpage, true));
-  }
-  file_seek(fi->file, 0);
+  /* pages are read in on first touch */
+  page_add_vma(addr, new_mmf->file, 0, filelen,
+               PGSIZE * (filelen/PGSIZE + 1) - filelen, true, true);
 
   return new_mmf->mapid;
 }
@@ -601,35 +630,16 @@ void syscall_munmap(mapid_t mapping)
   if(!found)
     printf("syscall_munmap: mmf not found\n");
   
+  /* pages evicted earlier were written back then; only the
+     resident ones may still be dirty */
   for(i = 0; i < mmf->filelen/PGSIZE + 1; i++)
   {
     uint32_t *upage = mmf->addr + PGSIZE * i;
-    uint32_t *kpage = page_pte_lookup(upage)->paddr;
-    int size = mmf->filelen - file_tell(mmf->file);
-    size = size > PGSIZE ? PGSIZE : size;
-
-    if(page_pte_lookup(upage)->is_swapped_out)
-    {
-      FTE *fte = frame_fifo_fte();
-      if(fte!=NULL)
-        swap_out(fte->uaddr);
-      swap_in(upage);
-      kpage = page_pte_lookup(upage)->paddr;
-    }
-
-    if(pagedir_is_dirty(thread_current()->pagedir, upage) == false)
+    if(page_pte_lookup(upage) == NULL)
       continue;
-
-    file_write(mmf->file, kpage, size);
-  }
-
-  for(i = 0; i < mmf->filelen/PGSIZE + 1; i++)
-  {
-    uint32_t *upage = mmf->addr + PGSIZE * i;
-    ASSERT(page_pte_lookup(upage));
-    frame_remove_fte(page_pte_lookup(upage)->paddr);
-    page_remove_pte(upage);
+    page_unmap(upage);
   }
+  page_remove_vma(mmf->addr);
 
   file_close(mmf->file);
   list_remove(&mmf->elem);
@@ -727,7 +737,7 @@ bool syscall_readdir(int fd, char *name)
     
     fi = list_entry(e, struct file_info, elem);
     // printf("fi fd : %d\n", fi->fd);
-    if(fi->fd == fd)
+    if(fi->fd == fd && fi->opener == thread_current()->tid)
     {
 
       found = true;
@@ -754,7 +764,7 @@ bool syscall_isdir(int fd)
   for(e = list_begin(&openfile_list); e != list_end(&openfile_list); e = list_next(e))
   {
     fi = list_entry(e, struct file_info, elem);
-    if(fi->fd == fd)
+    if(fi->fd == fd && fi->opener == thread_current()->tid)
     {
       found = true;
       break;
@@ -776,7 +786,7 @@ int syscall_inumber(int fd)
   for(e = list_begin(&openfile_list); e != list_end(&openfile_list); e = list_next(e))
   {
     fi = list_entry(e, struct file_info, elem);
-    if(fi->fd == fd)
+    if(fi->fd == fd && fi->opener == thread_current()->tid)
     {
       found = true;
       break;
@@ -789,6 +799,161 @@ int syscall_inumber(int fd)
   return inode_get_inumber(fi->file->inode);
 }
 
+/* Copies the VM statistics into ST in user memory. */
+bool syscall_vmstat(struct vmstat *st)
+{
+  struct vmstat kst;
+
+  if(st == NULL || !is_user_vaddr(st) || !is_user_vaddr(st + 1))
+    syscall_exit(-1);
+
+  frame_vmstat(&kst);
+  memcpy(st, &kst, sizeof kst);
+  return true;
+}
+
+/* Limits the running process to PAGES resident pages, at least
+   FRAME_RSS_MIN, or lifts the limit if PAGES is 0, and returns
+   the old limit. A negative PAGES leaves the limit as it is.
+   Pages over a new, lower limit are evicted when the process
+   faults in its next page. */
+int syscall_rsslimit(int pages)
+{
+  int old = thread_current()->rss_limit;
+
+  if(pages > 0 && pages < FRAME_RSS_MIN)
+    pages = FRAME_RSS_MIN;
+  if(pages >= 0)
+    thread_current()->rss_limit = pages;
+  return old;
+}
+
+/* Maps a zeroed 4 MB page at ADDR, which must be 4 MB aligned
+   and free, for a big heap or array. The mapping lasts until
+   the process exits. */
+bool syscall_map_large(void *addr)
+{
+  if(!is_user_vaddr(addr))
+    syscall_exit(-1);
+  return page_map_large(addr);
+}
+
+/* Copies the string STR, in user memory, into a new block, or
+   returns a null pointer if memory runs out. Its pages need not
+   be resident: reading them faults them in, as it would in the
+   process. Kills the process if STR runs into kernel memory or
+   unmapped user memory. */
+static char *copy_in_string(const char *str)
+{
+  char *kstr;
+  size_t len;
+
+  if(str == NULL)
+    syscall_exit(-1);
+  for(len = 0; ; len++)
+  {
+    if(!is_user_vaddr(str + len))
+      syscall_exit(-1);
+    if(str[len] == '\0')
+      break;
+  }
+
+  kstr = malloc(len + 1);
+  if(kstr != NULL)
+    memcpy(kstr, str, len + 1);
+  return kstr;
+}
+
+/* Starts CMD_LINE with the FD_CNT files in FDS, in user memory,
+   mapped into it, and returns its pid, or -1. */
+pid_t syscall_spawn(const char *cmd_line, const struct spawn_fd *fds, int fd_cnt)
+{
+  struct spawn_fd kfds[SPAWN_FD_MAX];
+  char *kcmd_line;
+  pid_t pid;
+
+  if(fd_cnt < 0 || fd_cnt > SPAWN_FD_MAX)
+    return -1;
+  if(fd_cnt > 0
+     && (fds == NULL || !is_user_vaddr(fds) || !is_user_vaddr(fds + fd_cnt)))
+    syscall_exit(-1);
+
+  memcpy(kfds, fds, fd_cnt * sizeof *kfds);
+  kcmd_line = copy_in_string(cmd_line);
+  if(kcmd_line == NULL)
+    return -1;
+  pid = process_spawn(kcmd_line, kfds, fd_cnt);
+  free(kcmd_line);
+  return pid;
+}
+
+/* Copies the CNT pids in PIDS, in user memory, into a new array,
+   or returns a null pointer. Kills the process if PIDS is bad. */
+static pid_t *copy_pids(const pid_t *pids, int cnt)
+{
+  pid_t *kpids;
+
+  if(cnt <= 0 || cnt > PGSIZE)
+    return NULL;
+  if(pids == NULL || !is_user_vaddr(pids) || !is_user_vaddr(pids + cnt))
+    syscall_exit(-1);
+
+  kpids = malloc(cnt * sizeof *kpids);
+  if(kpids != NULL)
+    memcpy(kpids, pids, cnt * sizeof *kpids);
+  return kpids;
+}
+
+/* Waits for one of the CNT spawned children in PIDS to exit,
+   stores its exit status in *STATUS and returns its pid, or
+   returns -1. */
+pid_t syscall_wait_any(const pid_t *pids, int cnt, int *status)
+{
+  pid_t *kpids;
+  pid_t pid;
+  int kstatus;
+
+  if(status == NULL || !is_user_vaddr(status + 1))
+    syscall_exit(-1);
+  kpids = copy_pids(pids, cnt);
+  if(kpids == NULL)
+    return -1;
+
+  pid = process_wait_any(kpids, cnt, &kstatus);
+  free(kpids);
+  if(pid != -1)
+    *status = kstatus;
+  return pid;
+}
+
+/* Waits for all of the CNT spawned children in PIDS to exit and
+   stores their exit statuses in STATUS[]. */
+bool syscall_wait_all(const pid_t *pids, int cnt, int *status)
+{
+  pid_t *kpids;
+  int *kstatus;
+  bool success;
+
+  if(status == NULL || !is_user_vaddr(status) || !is_user_vaddr(status + cnt))
+    syscall_exit(-1);
+  kpids = copy_pids(pids, cnt);
+  if(kpids == NULL)
+    return false;
+  kstatus = malloc(cnt * sizeof *kstatus);
+  if(kstatus == NULL)
+    {
+      free(kpids);
+      return false;
+    }
+
+  success = process_wait_all(kpids, cnt, kstatus);
+  if(success)
+    memcpy(status, kstatus, cnt * sizeof *kstatus);
+  free(kpids);
+  free(kstatus);
+  return success;
+}
+
 
 
 
@@ -828,6 +993,18 @@ char * system_call(int syscall)
     return "mmap";           
     case SYS_MUNMAP:      
     return "munmap";  
+    case SYS_VMSTAT:
+    return "vmstat";
+    case SYS_RSSLIMIT:
+    return "rsslimit";
+    case SYS_MAPLARGE:
+    return "map_large";
+    case SYS_SPAWN:
+    return "spawn";
+    case SYS_WAIT_ANY:
+    return "wait_any";
+    case SYS_WAIT_ALL:
+    return "wait_all";
     default:
     return "unknown system call";         
   }
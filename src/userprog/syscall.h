@@ -8,6 +8,8 @@
 #include <stdint.h>
 #include "filesys/file.h"
 #include "filesys/directory.h"
+#include <vmstat.h>
+#include <spawn.h>
 
 typedef int pid_t;
 typedef int mapid_t;
@@ -45,5 +47,11 @@ bool syscall_mkdir(const char *dir);
 bool syscall_readdir(int fd, char *name);
 bool syscall_isdir(int fd);
 int syscall_inumber(int fd);
+bool syscall_vmstat(struct vmstat *st);
+int syscall_rsslimit(int pages);
+bool syscall_map_large(void *addr);
+pid_t syscall_spawn(const char *cmd_line, const struct spawn_fd *fds, int fd_cnt);
+pid_t syscall_wait_any(const pid_t *pids, int cnt, int *status);
+bool syscall_wait_all(const pid_t *pids, int cnt, int *status);
 
 #endif /* userprog/syscall.h */
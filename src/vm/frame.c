@@ -1,9 +1,63 @@
 #include "vm/frame.h"
+#include <stdio.h>
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
 #include "vm/page.h"
 #include "vm/swap.h"
 
 unsigned frame_hash_hash_helper(const struct hash_elem * element, void * aux);
 bool frame_hash_less_helper(const struct hash_elem *a, const struct hash_elem *b, void *aux);
+static unsigned frame_file_hash(const struct hash_elem *element, void *aux);
+static bool frame_file_less(const struct hash_elem *a, const struct hash_elem *b, void *aux);
+
+/* Page cache: the frames holding unmodified file pages, keyed by
+   (inode, write_gen, ofs, read_bytes), so that processes running
+   the same executable find each other's pages. A write to the
+   file moves it to a new generation, so the frames read before
+   are not found anymore. */
+static struct hash file_frames;
+
+static struct list_elem *clock_hand;  /* next frame the clock looks at */
+static struct list_elem *clean_hand;  /* next frame the cleaner looks at */
+
+/* The page-out daemon keeps at least FRAME_LOW_WATER user pages
+   free: once fewer are left it is woken up and evicts pages, so
+   that faults under memory pressure find a free frame instead of
+   waiting for a page to be written out. Until FRAME_HIGH_WATER
+   are free it goes on cleaning dirty pages that have left their
+   working set, writing them out but leaving them resident, so
+   that the evictions to come find clean pages that are dropped
+   without a write. */
+#define FRAME_LOW_WATER 16
+#define FRAME_HIGH_WATER 32
+
+bool pageout_daemon;                  /* -pageout: run the daemon? */
+static struct semaphore pageout_sema; /* wakes up the daemon */
+static void frame_pageout(void *aux);
+
+/* Replacement policy. A process may own at most rss_limit frames
+   (0 for no limit, -rss sets the default); past it, every new
+   frame costs it one of its own. Otherwise a full user pool is
+   refilled from all processes, or with -replace=local from the
+   faulting process first.
+
+   Victims are chosen by working set (WSClock): every
+   WS_INTERVAL timer ticks the accessed bits of all frames are
+   sampled into their last_used tick, and a frame not used for
+   WS_WINDOW ticks has left the working set of its process and
+   is evicted before any frame that is still in one. */
+#define WS_INTERVAL 10
+#define WS_WINDOW 100
+
+int frame_rss_limit;                  /* -rss=PAGES */
+bool frame_local_replace;             /* -replace=local */
+static int64_t ws_last_sample;        /* tick of the last sample */
+static bool frame_test_accessed(FTE *fte);
+
+/* Counters are updated where the events happen: faults in the
+   page fault handler, swap traffic in swap.c. */
+struct vmstat vm_stat;
 
 void frame_init(void)
 {
@@ -11,14 +65,84 @@ void frame_init(void)
 
 	sema_down(&frame_sema);
 	hash_init(&frame_table, frame_hash_hash_helper, frame_hash_less_helper, NULL);
+	hash_init(&file_frames, frame_file_hash, frame_file_less, NULL);
 	list_init(&fte_list);
+	clock_hand = NULL;
+	clean_hand = NULL;
 	sema_up(&frame_sema);
 }
 
+/* Starts the page-out daemon. */
+void frame_pageout_init(void)
+{
+	sema_init(&pageout_sema, 0);
+	thread_create("pageout", PRI_DEFAULT, frame_pageout, NULL);
+}
+
+/* Page-out daemon. Sleeps until the user pool drops below the low
+   watermark, then evicts until it is back above it, and cleans
+   pages while it is still below the high one. */
+static void frame_pageout(void *aux)
+{
+	for(;;)
+	{
+		int i;
+		sema_down(&pageout_sema);
+		/* bounded, in case the pool is smaller than the watermark */
+		for(i = 0; i < FRAME_HIGH_WATER; i++)
+		{
+			size_t free_cnt = palloc_user_free_cnt();
+			if(free_cnt >= FRAME_HIGH_WATER)
+				break;
+			if(free_cnt < FRAME_LOW_WATER ? !frame_evict() : !frame_clean())
+				break;
+		}
+	}
+}
+
+/* Samples the accessed bits of all frames if WS_INTERVAL ticks
+   have passed since the last time, and recounts the working set
+   of every process that owns a frame. Must be called with
+   frame_sema held. */
+static void frame_ws_sample(void)
+{
+	int64_t now = timer_ticks();
+	struct list_elem *e;
+
+	if(now - ws_last_sample < WS_INTERVAL)
+		return;
+	ws_last_sample = now;
+
+	for(e = list_begin(&fte_list); e != list_end(&fte_list); e = list_next(e))
+		list_entry(e, FTE, elem)->owner->ws_size = 0;
+	for(e = list_begin(&fte_list); e != list_end(&fte_list); e = list_next(e))
+	{
+		FTE *fte = list_entry(e, FTE, elem);
+		if(fte->owner->pagedir != NULL)
+			frame_test_accessed(fte);
+		if(now - fte->last_used < WS_WINDOW)
+			fte->owner->ws_size++;
+	}
+}
+
+/* Returns true if T owns as many frames as it may. */
+bool frame_over_limit(struct thread *t)
+{
+	return t->rss_limit != 0 && t->rss >= t->rss_limit;
+}
+
 uint8_t* frame_get_fte(uint32_t *upage, enum palloc_flags flag)
 {
 	if(upage == NULL) return NULL;
 
+	/* stay within the RSS limit by giving up frames of our own.
+	   While none of them can go because they are in transit, wait
+	   for transits to end; if they are all shared or still being
+	   filled, go over the limit for now rather than fail */
+	while(frame_over_limit(thread_current()))
+		if(!frame_evict_from(thread_current()) && !swap_transit_wait_any())
+			break;
+
 	uint32_t *kpage = palloc_get_page(flag);
 	// if(kpage==NULL) printf("palloc failed\n");
 	// printf("KPAGE : %p\n", kpage);
@@ -33,12 +157,42 @@ uint8_t* frame_get_fte(uint32_t *upage, enum palloc_flags flag)
 		return NULL;
 	}
 	frame_set_fte(upage, kpage);
+	frame_ws_sample();
 	sema_up(&frame_sema);
 	// printf("FRAME SEMA AFTER %d\n", frame_sema.value);
 
+	if(pageout_daemon && palloc_user_free_cnt() < FRAME_LOW_WATER)
+		sema_up(&pageout_sema);
+
 	return kpage;
 }
 
+/* Returns a frame for UPAGE like frame_get_fte(), evicting pages
+   as long as the user pool is exhausted. If nothing can be
+   evicted because the candidates are being written out, waits
+   until one of them is; if they are still being filled in, gives
+   the threads filling them a tick, up to FRAME_ALLOC_TRIES times.
+   Returns NULL if no frame turns up, which the caller reports as
+   a failed fault. */
+#define FRAME_ALLOC_TRIES 100
+
+uint8_t* frame_alloc(uint32_t *upage, enum palloc_flags flag)
+{
+	int tries = 0;
+
+	for(;;)
+	{
+		uint8_t *kpage = frame_get_fte(upage, flag);
+		if(kpage != NULL)
+			return kpage;
+		if(frame_evict() || swap_transit_wait_any())
+			continue;
+		if(++tries > FRAME_ALLOC_TRIES)
+			return NULL;
+		timer_sleep(1);
+	}
+}
+
 bool frame_set_fte(uint32_t *upage, uint32_t *kpage)
 {
 	FTE* new_fte = (FTE*)malloc(sizeof(FTE));
@@ -46,6 +200,15 @@ bool frame_set_fte(uint32_t *upage, uint32_t *kpage)
 	new_fte->uaddr = upage;
 	// new_fte->is_swapped_out = false;
 	new_fte->usertid = thread_current()->tid;
+	new_fte->owner = thread_current();
+	new_fte->owner->rss++;
+	new_fte->last_used = timer_ticks();
+	new_fte->refcnt = 1;
+	list_init(&new_fte->sharers);
+	new_fte->inode = NULL;
+	new_fte->write_gen = 0;
+	new_fte->ofs = 0;
+	new_fte->read_bytes = 0;
 
 	hash_insert(&frame_table, &new_fte->helem);
 	list_push_back(&fte_list, &new_fte->elem);
@@ -66,13 +229,7 @@ void frame_remove_fte(uint32_t* kpage)
 	ASSERT(fte->paddr == kpage);
 	// ASSERT(fte->usertid == thread_current()->tid);
 
-	hash_delete(&frame_table, &fte->helem);
-	list_remove(&fte->elem);
-	
-	palloc_free_page(kpage);
-	pagedir_clear_page(thread_current()->pagedir, fte->uaddr);
-
-	free(fte);
+	frame_unmap(fte, thread_current());
 
 	sema_up(&frame_sema);
 	// printf("FRAME SEMA AFTER\n");
@@ -80,77 +237,304 @@ void frame_remove_fte(uint32_t* kpage)
 
 
 
-FTE* frame_fifo_fte(void)
+/* Returns the frame under *HAND and advances the hand, wrapping
+   around the end of fte_list. */
+static FTE* frame_clock_next(struct list_elem **hand)
 {
-	int currtid = thread_current()->tid;
-	struct list_elem *e = list_begin(&fte_list);
-	int partid = thread_current()->parent->tid;
-	FTE *fte = NULL;
-	
-	int num = 0;
-	for(; e != list_end(&fte_list); e = list_next(e)){
-		FTE *fte = list_entry(e, FTE, elem);
-		// printf("fifo fte->tid : %d , curr tid : %d ", fte->usertid, currtid);
-		if(fte->usertid == currtid){
-			num++;
-		}
+	if(*hand == NULL || *hand == list_end(&fte_list))
+		*hand = list_begin(&fte_list);
+	FTE *fte = list_entry(*hand, FTE, elem);
+	*hand = list_next(*hand);
+	return fte;
+}
 
+/* Returns true if any process that maps FTE accessed it since
+   the last call, clearing the accessed bits and recording the
+   time in FTE's last_used. */
+static bool frame_test_accessed(FTE *fte)
+{
+	bool accessed = false;
+	struct list_elem *e;
+
+	if(pagedir_is_accessed(fte->owner->pagedir, fte->uaddr))
+	{
+		pagedir_set_accessed(fte->owner->pagedir, fte->uaddr, false);
+		accessed = true;
 	}
-	// print("NUM : %d\n", num);
-	if(num < 5){
-		goto PARENT_SWAP;
+	for(e = list_begin(&fte->sharers); e != list_end(&fte->sharers); e = list_next(e))
+	{
+		PTE *pte = list_entry(e, PTE, selem);
+		if(pagedir_is_accessed(pte->owner->pagedir, pte->uaddr))
+		{
+			pagedir_set_accessed(pte->owner->pagedir, pte->uaddr, false);
+			accessed = true;
+		}
 	}
-	e = list_begin(&fte_list);
-	for(; e != list_end(&fte_list); e = list_next(e))
+	if(accessed)
+		fte->last_used = timer_ticks();
+	return accessed;
+}
+
+/* Chooses a victim frame with the clock over all frames, or
+   over T's only if T is not NULL. A frame whose accessed bit is
+   set has the bit cleared and is passed over. The first frame
+   found neither in its process's working set nor dirty is taken.
+   Otherwise, within two sweeps, the first one found out of the
+   working set but dirty, then in the working set but clean, then
+   in the working set and dirty. A frame not mapped at its page
+   yet is still being filled, possibly while the page maps
+   another frame, as a copy-on-write copy does, and a page in
+   transit is being written, so neither is ever chosen. Must be
+   called with frame_sema held. */
+FTE* frame_clock_fte(struct thread *t)
+{
+	FTE *victim[3] = {NULL, NULL, NULL};
+	size_t n = list_size(&fte_list), i;
+	int64_t now = timer_ticks();
+
+	for(i = 0; i < 2*n; i++)
 	{
-		FTE *fte = list_entry(e, FTE, elem);
-		// printf("fifo fte->tid : %d , curr tid : %d ", fte->usertid, currtid);
-		if(fte->usertid == currtid){
-			return fte;
+		FTE *fte = frame_clock_next(&clock_hand);
+		uint32_t *pd = fte->owner->pagedir;
+		PTE *pte;
+		int rank;
+
+		if(t != NULL && fte->owner != t)
+			continue;
+		if(pd == NULL || pagedir_get_page(pd, fte->uaddr) != fte->paddr)
+			continue;
+		pte = page_thread_lookup(fte->uaddr, fte->owner);
+		if(pte == NULL || pte->in_transit)
+			continue;
+		if(frame_test_accessed(fte))
+			continue;
+		bool dirty = pagedir_is_dirty(pd, fte->uaddr);
+		if(now - fte->last_used >= WS_WINDOW)
+		{
+			if(!dirty)
+				return fte;
+			rank = 0;
 		}
+		else
+			rank = dirty ? 2 : 1;
+		if(victim[rank] == NULL)
+			victim[rank] = fte;
 	}
-PARENT_SWAP:
-	// NOT_REACHED();
-	
+	for(i = 0; i < 3; i++)
+		if(victim[i] != NULL)
+			return victim[i];
+	return NULL;
+}
 
-	
-	e = list_begin(&fte_list);
-	for(; e != list_end(&fte_list); e = list_next(e))
+/* Chooses a page to clean with a clock of its own: the first
+   frame found mapped, dirty and out of its process's working
+   set, within one sweep. Must be called with frame_sema held. */
+static FTE* frame_clean_fte(void)
+{
+	size_t n = list_size(&fte_list), i;
+	int64_t now = timer_ticks();
+
+	for(i = 0; i < n; i++)
 	{
-		fte = list_entry(e, FTE, elem);
-		if(fte->usertid == partid)
-			break;
-	}	
-	// printf("FTE UADDR : %p\n", fte->uaddr);
-	
-	swap_parent(fte->uaddr);
+		FTE *fte = frame_clock_next(&clean_hand);
+		uint32_t *pd = fte->owner->pagedir;
+		PTE *pte;
+
+		if(pd == NULL || pagedir_get_page(pd, fte->uaddr) != fte->paddr)
+			continue;
+		if(!pagedir_is_dirty(pd, fte->uaddr) || !list_empty(&fte->sharers))
+			continue;
+		pte = page_thread_lookup(fte->uaddr, fte->owner);
+		if(pte == NULL || pte->in_transit)
+			continue;
+		if(now - fte->last_used >= WS_WINDOW && !frame_test_accessed(fte))
+			return fte;
+	}
 	return NULL;
 }
 
-void parent_remove_fte(uint32_t* kpage, struct thread* parent)
+/* Writes out one dirty page that has left the working set of its
+   process, ahead of its eviction, and leaves it resident. Returns
+   false if there is no such page. */
+bool frame_clean(void)
 {
-	ASSERT(kpage!=NULL);
-	
+	bool success = false;
+
 	sema_down(&frame_sema);
+	frame_ws_sample();
+	FTE *fte = frame_clean_fte();
+	if(fte != NULL)
+		success = swap_clean(fte);
+	sema_up(&frame_sema);
 
-	FTE* fte = frame_fte_lookup(kpage);
-	if(fte == NULL){
-		sema_up(&frame_sema);
-		return;
+	return success;
+}
+
+/* Frees one frame because the user pool is exhausted, by
+   writing a page out to swap. Under local replacement the page
+   is one of the running process's own if it has any. Returns
+   false if no frame could be evicted. */
+bool frame_evict(void)
+{
+	struct thread *t = thread_current();
+
+	if(frame_local_replace && t->rss > 0 && frame_evict_from(t))
+		return true;
+	return frame_evict_from(NULL);
+}
+
+/* Frees one frame of T, or of any process if T is NULL, by
+   writing the page chosen by the clock out to swap. Returns false
+   if no frame could be evicted. */
+bool frame_evict_from(struct thread *t)
+{
+	bool success = false;
+
+	sema_down(&frame_sema);
+	frame_ws_sample();
+	FTE *fte = frame_clock_fte(t);
+	if(fte != NULL)
+	{
+		vm_stat.evictions++;
+		success = swap_out(fte);
 	}
-	ASSERT(fte->paddr == kpage);
-	ASSERT(fte->usertid == parent->tid);
+	sema_up(&frame_sema);
 
+	return success;
+}
+
+/* Removes FTE from the frame table, unmaps it from its owner and
+   frees the frame. Must be called with frame_sema held. */
+void frame_free_fte(FTE *fte)
+{
+	ASSERT(list_empty(&fte->sharers));
+	frame_file_remove(fte);
+	if(clock_hand == &fte->elem)
+		clock_hand = list_next(clock_hand);
+	if(clean_hand == &fte->elem)
+		clean_hand = list_next(clean_hand);
 	hash_delete(&frame_table, &fte->helem);
 	list_remove(&fte->elem);
-	
-	palloc_free_page(kpage);
-	pagedir_clear_page(parent->pagedir, fte->uaddr);
+
+	if(fte->owner->pagedir != NULL)
+		pagedir_clear_page(fte->owner->pagedir, fte->uaddr);
+	fte->owner->rss--;
+	palloc_free_page(fte->paddr);
 
 	free(fte);
+}
 
-	sema_up(&frame_sema);
-	// printf("FRAME SEMA AFTER\n");
+/* Removes thread T's mapping of FTE. The frame is freed when T
+   was the last one to map it; otherwise, if T owned it, the next
+   sharer becomes the owner. Must be called with frame_sema
+   held. */
+void frame_unmap(FTE *fte, struct thread *t)
+{
+	struct list_elem *e;
+
+	if(fte->owner == t)
+	{
+		if(list_empty(&fte->sharers))
+		{
+			frame_free_fte(fte);
+			return;
+		}
+		if(t->pagedir != NULL)
+			pagedir_clear_page(t->pagedir, fte->uaddr);
+
+		PTE *next = list_entry(list_pop_front(&fte->sharers), PTE, selem);
+		t->rss--;
+		next->owner->rss++;
+		fte->owner = next->owner;
+		fte->uaddr = next->uaddr;
+		fte->usertid = next->owner->tid;
+		fte->refcnt--;
+		return;
+	}
+
+	for(e = list_begin(&fte->sharers); e != list_end(&fte->sharers); e = list_next(e))
+	{
+		PTE *pte = list_entry(e, PTE, selem);
+		if(pte->owner == t)
+		{
+			list_remove(e);
+			if(t->pagedir != NULL)
+				pagedir_clear_page(t->pagedir, pte->uaddr);
+			fte->refcnt--;
+			return;
+		}
+	}
+}
+
+/* Adds PTE's process to the processes that map FTE. The caller
+   maps the page read-only. Must be called with frame_sema held. */
+void frame_share(FTE *fte, PTE *pte)
+{
+	ASSERT(fte->inode != NULL);
+	list_push_back(&fte->sharers, &pte->selem);
+	fte->refcnt++;
+}
+
+/* Returns a resident frame holding the unmodified page of INODE
+   at OFS with READ_BYTES bytes read from it, read since INODE
+   was last written, or NULL. Must be called with frame_sema
+   held. */
+FTE* frame_file_lookup(struct inode *inode, off_t ofs, size_t read_bytes)
+{
+	FTE fte;
+	struct hash_elem *helem;
+
+	fte.inode = inode;
+	fte.write_gen = inode_write_gen(inode);
+	fte.ofs = ofs;
+	fte.read_bytes = read_bytes;
+	helem = hash_find(&file_frames, &fte.file_elem);
+
+	return helem!=NULL ? hash_entry(helem, FTE, file_elem) : NULL;
+}
+
+/* Enters FTE, which holds the page of INODE at OFS with
+   READ_BYTES bytes read, into the page cache. WRITE_GEN is
+   INODE's inode_write_gen() from before the page was read, so
+   that a write during the read makes the page stale at once. If
+   another frame holds the same page already, FTE stays private.
+   Must be called with frame_sema held. */
+void frame_file_add(FTE *fte, struct inode *inode, unsigned write_gen, off_t ofs, size_t read_bytes)
+{
+	ASSERT(fte->inode == NULL);
+	fte->inode = inode;
+	fte->write_gen = write_gen;
+	fte->ofs = ofs;
+	fte->read_bytes = read_bytes;
+	if(hash_insert(&file_frames, &fte->file_elem) != NULL)
+		fte->inode = NULL;
+}
+
+/* Takes FTE out of the page cache, as its page is about to be
+   modified or freed. Must be called with frame_sema held. */
+void frame_file_remove(FTE *fte)
+{
+	if(fte->inode == NULL)
+		return;
+	hash_delete(&file_frames, &fte->file_elem);
+	fte->inode = NULL;
+}
+
+static unsigned frame_file_hash(const struct hash_elem *element, void *aux)
+{
+	FTE *fte = hash_entry(element, FTE, file_elem);
+	return hash_bytes(&fte->inode, sizeof fte->inode) ^ hash_int(fte->write_gen)
+		^ hash_int(fte->ofs) ^ hash_int(fte->read_bytes);
+}
+
+static bool frame_file_less(const struct hash_elem *a, const struct hash_elem *b, void *aux)
+{
+	FTE *x = hash_entry(a, FTE, file_elem);
+	FTE *y = hash_entry(b, FTE, file_elem);
+	if(x->inode != y->inode) return x->inode < y->inode;
+	if(x->write_gen != y->write_gen) return x->write_gen < y->write_gen;
+	if(x->ofs != y->ofs) return x->ofs < y->ofs;
+	return x->read_bytes < y->read_bytes;
 }
 
 
@@ -186,4 +570,39 @@ bool frame_hash_less_helper(const struct hash_elem *a, const struct hash_elem *b
 	else return false;
 }
 
+/* Fills ST with the VM counters and the current state of the
+   frame table and swap, and the running thread's RSS. */
+void frame_vmstat(struct vmstat *st)
+{
+	sema_down(&frame_sema);
+	*st = vm_stat;
+	st->frames_used = hash_size(&frame_table);
+	sema_up(&frame_sema);
 
+	st->frames_free = palloc_user_free_cnt();
+	st->rss = page_rss(thread_current());
+	st->ws_size = thread_current()->ws_size;
+	st->rss_limit = thread_current()->rss_limit;
+	swap_vmstat(st);
+}
+
+/* Prints VM statistics. */
+void frame_print_stats(void)
+{
+	struct vmstat st;
+
+	frame_vmstat(&st);
+	printf("VM: %lld faults (%lld lazy, %lld stack, %lld swap-in, %lld cow, %lld zero), %lld evictions\n",
+		st.faults, st.lazy_faults, st.stack_faults, st.swapin_faults, st.cow_faults, st.zero_faults,
+		st.evictions);
+	printf("VM: %lld pages mapped by fault-around\n", st.around_pages);
+	printf("VM: %d frames used, %d free\n", st.frames_used, st.frames_free);
+	printf("Swap: %lld page-ins, %lld page-outs, %lld zero pages, %lld file write-backs\n",
+		st.pageins, st.pageouts, st.zero_pageouts, st.writebacks);
+	printf("Swap: %lld read ticks, %lld write ticks\n", st.swap_read_ticks, st.swap_write_ticks);
+	printf("Swap: %d of %d slots used, %d peak, %d free runs\n",
+		st.swap_used, st.swap_slots, st.swap_peak, st.swap_free_runs);
+	if(st.zpool_size != 0)
+		printf("Zswap: %lld page-ins, %lld page-outs, %d pages in %d of %d bytes\n",
+			st.zpageins, st.zpageouts, st.zpool_pages, st.zpool_used, st.zpool_size);
+}
\ No newline at end of file
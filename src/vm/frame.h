@@ -4,20 +4,36 @@
 #include <stdbool.h>
 #include <list.h>
 #include <hash.h>
+#include <vmstat.h>
 #include "threads/init.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
 #include "threads/palloc.h"
 #include "userprog/pagedir.h"
 #include "threads/vaddr.h"
+#include "filesys/off_t.h"
 #include "vm/swap.h"
 #include "vm/page.h"
+struct inode;
+struct page_table_entry;
+
 typedef struct frame_table_entry
 {
 	uint32_t *uaddr;          /* virtual address of the page */
 	uint32_t *paddr;          /* physical address of the page */
 
 	int usertid;              /* process tid that use this frame */
+	struct thread *owner;     /* process that use this frame */
+	int refcnt;               /* number of processes that map it */
+	struct list sharers;      /* PTEs of the others that map it */
+	int64_t last_used;        /* timer tick it was last seen accessed */
+
+	/* Loaded from a file and unmodified, so it can be shared */
+	struct inode *inode;      /* file, or NULL if not shareable */
+	unsigned write_gen;       /* inode_write_gen() before the read */
+	off_t ofs;                /* offset in the file */
+	size_t read_bytes;        /* bytes read from the file */
+	struct hash_elem file_elem; /* element in the page cache */
 
 	struct list_elem elem;    /* list element */
 	struct hash_elem helem;   /* hash element */
@@ -29,14 +45,35 @@ struct list fte_list;         /* list of all FTE */
 
 struct semaphore frame_sema;  /* frame table semaphore */
 
+extern bool pageout_daemon;   /* run the page-out daemon */
+extern int frame_rss_limit;   /* default RSS limit of a process */
+#define FRAME_RSS_MIN 8       /* lowest RSS limit, so that any
+                                 instruction can make progress */
+extern bool frame_local_replace; /* evict from the faulting process */
+
+extern struct vmstat vm_stat; /* VM event counters */
+
 void frame_init(void);
+void frame_pageout_init(void);
 uint8_t* frame_get_fte(uint32_t *upage, enum palloc_flags flag);
+uint8_t* frame_alloc(uint32_t *upage, enum palloc_flags flag);
 bool frame_set_fte(uint32_t *upage, uint32_t *kpage);
-FTE* frame_fifo_fte(void);
+FTE* frame_clock_fte(struct thread *t);
+bool frame_evict(void);
+bool frame_evict_from(struct thread *t);
+bool frame_clean(void);
+bool frame_over_limit(struct thread *t);
+void frame_free_fte(FTE *fte);
+void frame_unmap(FTE *fte, struct thread *t);
+void frame_share(FTE *fte, struct page_table_entry *pte);
+FTE* frame_file_lookup(struct inode *inode, off_t ofs, size_t read_bytes);
+void frame_file_add(FTE *fte, struct inode *inode, unsigned write_gen, off_t ofs, size_t read_bytes);
+void frame_file_remove(FTE *fte);
 void frame_remove_fte(uint32_t* upage);
 FTE* frame_fte_lookup(uint32_t *addr);
+void frame_vmstat(struct vmstat *st);
+void frame_print_stats(void);
 void remove_fte(uint32_t* kpage);
-void parent_remove_fte(uint32_t* kpage, struct thread* parent);
 
 
 
@@ -1,24 +1,76 @@
 #include "vm/page.h"
-
-
-unsigned page_hash_hash_helper(const struct hash_elem * element, void * aux);
-bool page_hash_less_helper(const struct hash_elem *a, const struct hash_elem *b, void *aux);
+#include <string.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/pte.h"
+
+/* The supplemental page table is a two-level array that mirrors
+   the x86 page directory: t->pt is a page of pointers to tables
+   indexed by pd_no(), and each table is a page of PTE pointers
+   indexed by pt_no(). Both levels are allocated on first use,
+   so a lookup is two array accesses. */
+#define SPT_CNT (PGSIZE / sizeof(PTE *))
+
+static PTE** page_slot(struct thread *t, uint32_t *upage, bool create);
+
+/* A page of zeros in the kernel pool, mapped read-only in
+   place of every anonymous page that is read before it is
+   written: stack pages and pages of the executable that lie
+   wholly in its BSS. The first write gives the page a frame of
+   its own in page_cow(). The zero frame is not in the frame
+   table, so it is never evicted. */
+static uint8_t *zero_frame;
 
 void page_init(void)
 {
 	sema_init(&page_sema, 1);
+	zero_frame = palloc_get_page(PAL_ASSERT | PAL_ZERO);
 
 	// sema_down(&page_sema);
 	// hash_init(&page_table, page_hash_hash_helper, page_hash_less_helper, NULL);
 	// sema_up(&page_sema);
 }
 
-void page_table_init(struct hash* h){
+void page_table_init(struct thread *t){
 
-	if(h == NULL) return;
-	// sema_down(&page_sema);
-  	hash_init(h, page_hash_hash_helper, page_hash_less_helper, NULL);
-  	// sema_up(&page_sema);
+	if(t == NULL) return;
+	t->pt = NULL;
+}
+
+/* Returns the slot for UPAGE in T's supplemental page table. If
+   CREATE, missing tables are allocated. Returns NULL if there is
+   no slot for UPAGE (yet). */
+static PTE** page_slot(struct thread *t, uint32_t *upage, bool create)
+{
+	size_t pde = pd_no(upage);
+
+	if(t->pt == NULL)
+	{
+		if(!create || (t->pt = palloc_get_page(PAL_ZERO)) == NULL)
+			return NULL;
+	}
+	if(t->pt[pde] == NULL)
+	{
+		if(!create || (t->pt[pde] = palloc_get_page(PAL_ZERO)) == NULL)
+			return NULL;
+	}
+	return &t->pt[pde][pt_no(upage)];
+}
+
+/* Puts PTE into the current thread's supplemental page table,
+   unless its page has an entry already. */
+static bool page_insert(PTE *pte)
+{
+	PTE **slot = page_slot(thread_current(), pte->uaddr, true);
+	if(slot == NULL)
+		return false;
+	if(*slot == NULL)
+		*slot = pte;
+	else
+		free(pte);
+	return true;
 }
 
 bool lazy_load(uint32_t *upage, struct file *file, off_t ofs, 
@@ -33,13 +85,18 @@ bool lazy_load(uint32_t *upage, struct file *file, off_t ofs,
 		return false;
 	}
 
-	new_pte->paddr = -1;
+	new_pte->paddr = NULL;
 	new_pte->uaddr = upage;
 	new_pte->dirty = false;
 	new_pte->is_swapped_out = false;
+	new_pte->in_transit = false;
 	new_pte->writable = writable;
 	new_pte->usertid = thread_current()->tid;
+	new_pte->owner = thread_current();
 	new_pte->load = true;
+	new_pte->cow = false;
+	new_pte->mmap = false;
+	new_pte->zero = false;
 
 	new_pte->file = file;
 	new_pte->ofs = ofs;
@@ -47,27 +104,65 @@ bool lazy_load(uint32_t *upage, struct file *file, off_t ofs,
 	new_pte->page_zero_bytes = page_zero_bytes;
 	new_pte->load_result = false;
 
-	hash_insert(&thread_current()->pt, &new_pte->helem);
+	if(!page_insert(new_pte))
+		return false;
 	
 	// sema_up(&page_sema);
 
 	return true;
 }
 
-bool actual_load(uint32_t *upage)
+/* Maps the lazily loaded page UPAGE to the frame of another
+   process that has the same page of the same file resident and
+   unmodified, found in the page cache. The page is mapped
+   read-only; a writable one is copied on the first write in
+   page_cow(). Returns false if no such frame is resident. */
+bool page_share(uint32_t *upage)
 {
-	uint8_t *kpage = frame_get_fte(upage, PAL_USER|PAL_ZERO);
+	struct thread *t = thread_current();
 	PTE *pte = page_pte_lookup(upage);
-	ASSERT(pte != NULL);
+	ASSERT(pte != NULL && pte->load && !pte->load_result);
+	if(pte->mmap)
+		return false;
 
-	if(kpage == NULL)
+	struct inode *inode = file_get_inode(pte->file);
+
+	sema_down(&frame_sema);
+	FTE *fte = frame_file_lookup(inode, pte->ofs, pte->page_read_bytes);
+	if(fte == NULL)
 	{
-		FTE *fte = frame_fifo_fte();
-		if(fte != NULL)
-		  swap_out(fte->uaddr);
-		kpage = frame_get_fte(upage, PAL_USER | PAL_ZERO);
-		ASSERT(kpage != NULL);
+		sema_up(&frame_sema);
+		return false;
 	}
+	frame_share(fte, pte);
+	pte->cow = pte->writable;
+	pte->paddr = fte->paddr;
+	ASSERT(pagedir_get_page(t->pagedir, upage) == NULL);
+	ASSERT(pagedir_set_page(t->pagedir, upage, fte->paddr, false));
+	pte->load_result = true;
+	sema_up(&frame_sema);
+	return true;
+}
+
+/* Loads the lazily loaded page UPAGE, sharing the frame of
+   another process if it is resident. Writable pages are mapped
+   read-only until the first write, which copies them in
+   page_cow(), so that they can be shared too. */
+bool actual_load(uint32_t *upage)
+{
+	struct thread *t = thread_current();
+	PTE *pte = page_pte_lookup(upage);
+	FTE *fte;
+	ASSERT(pte != NULL);
+
+	if(page_share(upage))
+		return true;
+
+	struct inode *inode = file_get_inode(pte->file);
+	unsigned write_gen = inode_write_gen(inode);
+	pte->cow = pte->writable && !pte->mmap;
+
+	uint8_t *kpage = frame_alloc(upage, PAL_USER|PAL_ZERO);
 
 	pte->paddr = kpage;
 
@@ -85,10 +180,224 @@ bool actual_load(uint32_t *upage)
 	memset (kpage + pte->page_read_bytes, 0, pte->page_zero_bytes);
 
 	/* Add the page to the process's address space. */
-	ASSERT(pagedir_get_page(thread_current()->pagedir, upage) == NULL);
-	ASSERT(pagedir_set_page(thread_current()->pagedir, upage, kpage, pte->writable));
+	ASSERT(pagedir_get_page(t->pagedir, upage) == NULL);
+	ASSERT(pagedir_set_page(t->pagedir, upage, kpage, pte->writable && !pte->cow));
 
 	pte->load_result = true;
+
+	/* now others may share it */
+	if(!pte->mmap)
+	{
+		sema_down(&frame_sema);
+		fte = frame_fte_lookup((uint32_t *)kpage);
+		frame_file_add(fte, inode, write_gen, pte->ofs, pte->page_read_bytes);
+		sema_up(&frame_sema);
+	}
+	return true;
+}
+
+/* Fault-around: after a fault on the lazily loaded page UPAGE,
+   the other pages of the same area within its aligned window of
+   FAULT_AROUND pages that are resident in the page cache are
+   mapped too, at no cost but a page table entry each, saving
+   the faults on them. Pages that are not resident are left to
+   their own faults: loading them here would take frames, and
+   possibly other processes' pages, for accesses that may never
+   come. */
+#define FAULT_AROUND 16
+
+void page_fault_around(uint32_t *upage)
+{
+	struct thread *t = thread_current();
+	VMA *vma = page_vma_lookup(upage);
+	uint8_t *start, *end, *p;
+
+	if(vma == NULL)
+		return;
+	start = (uint8_t *)ROUND_DOWN((uintptr_t)upage, FAULT_AROUND * PGSIZE);
+	end = start + FAULT_AROUND * PGSIZE;
+	if(start < vma->start)
+		start = vma->start;
+	if(end > vma->end)
+		end = vma->end;
+
+	for(p = start; p < end; p += PGSIZE)
+	{
+		PTE *pte;
+
+		if(p == (uint8_t *)upage || pagedir_get_page(t->pagedir, p) != NULL)
+			continue;
+		pte = page_pte_get((uint32_t *)p);
+		if(pte == NULL || !pte->load || pte->load_result || pte->is_swapped_out
+			|| pte->in_transit)
+			continue;
+		if(page_share((uint32_t *)p))
+			vm_stat.around_pages++;
+	}
+}
+
+/* Maps the zero frame read-only at UPAGE, for a read of a page
+   that holds nothing but zeros: a lazily loaded page with no
+   bytes from its file, or a new stack page if UPAGE has no page
+   yet. Returns false if UPAGE is some other page. */
+bool page_zero_map(uint32_t *upage)
+{
+	struct thread *t = thread_current();
+	PTE *pte = page_pte_lookup(upage);
+
+	if(pte == NULL)
+	{
+		page_map(upage, (uint32_t *)zero_frame, true);
+		pte = page_pte_lookup(upage);
+		if(pte == NULL)
+			return false;
+	}
+	else if(!pte->load || pte->load_result || pte->mmap || pte->page_read_bytes != 0)
+		return false;
+	else
+	{
+		pte->paddr = (uint32_t *)zero_frame;
+		pte->load_result = true;
+	}
+
+	pte->zero = true;
+	ASSERT(pagedir_get_page(t->pagedir, upage) == NULL);
+	ASSERT(pagedir_set_page(t->pagedir, upage, zero_frame, false));
+	return true;
+}
+
+/* Maps a zeroed, writable 4 MB page at UPAGE, which must be 4 MB
+   aligned, for a process that asks for a big region without the
+   TLB misses and page tables of 1024 small pages. The page must
+   not overlap anything else, and it is pinned: it is not in the
+   frame table, so it is never evicted, and it is freed along
+   with the page directory when the process exits. Returns false
+   if 4 MB pages are not enabled or no 4 MB of the user pool are
+   free and aligned. */
+bool page_map_large(uint8_t *upage)
+{
+	struct thread *t = thread_current();
+	uint8_t *kpage;
+
+	if(!pse_enabled || upage == NULL || (uintptr_t)upage % PTSPAN != 0)
+		return false;
+	if(!is_user_vaddr(upage + PTSPAN - 1) || upage + PTSPAN > (uint8_t *)PHYS_BASE - (uintptr_t)STACK_MAX)
+		return false;
+	if(page_vma_overlaps(upage, upage + PTSPAN))
+		return false;
+	/* no page of ours, resident or not, in the range */
+	if(t->pt != NULL && t->pt[pd_no(upage)] != NULL)
+		return false;
+
+	kpage = palloc_get_large(PAL_USER | PAL_ZERO);
+	if(kpage == NULL)
+		return false;
+	if(!pagedir_set_large_page(t->pagedir, upage, kpage, true))
+	{
+		palloc_free_multiple(kpage, PTSPAN / PGSIZE);
+		return false;
+	}
+	return true;
+}
+
+/* Removes the memory-mapped page UPAGE, writing it back to its
+   file first if it is resident and dirty. An eviction under way
+   writes it back itself and is waited for. The page is in
+   transit during the write, which is done without frame_sema,
+   so that it is not evicted meanwhile. */
+void page_unmap(uint32_t *upage)
+{
+	struct thread *t = thread_current();
+	PTE *pte = page_pte_lookup(upage);
+	FTE *fte = NULL;
+	ASSERT(pte != NULL && pte->mmap);
+
+	swap_transit_wait(pte);
+
+	sema_down(&frame_sema);
+	if(pte->load_result && pte->paddr != NULL)
+		fte = frame_fte_lookup(pte->paddr);
+	if(fte != NULL && pagedir_is_dirty(t->pagedir, upage))
+	{
+		swap_transit_begin(pte);
+		sema_up(&frame_sema);
+		file_write_at(pte->file, fte->paddr, pte->page_read_bytes, pte->ofs);
+		vm_stat.writebacks++;
+		sema_down(&frame_sema);
+		swap_transit_end(pte);
+	}
+	if(fte != NULL)
+		frame_unmap(fte, t);
+	sema_up(&frame_sema);
+
+	page_remove_pte(upage);
+}
+
+/* Handles a write to the copy-on-write page UPAGE. The page just
+   becomes writable if no other process maps its frame; otherwise
+   it is copied to a private frame first. A page mapped to the
+   zero frame gets a new zeroed frame. Returns false if UPAGE is
+   not copy-on-write or no frame is left for the copy. */
+bool page_cow(uint32_t *upage)
+{
+	struct thread *t = thread_current();
+	PTE *pte = page_pte_lookup(upage);
+	FTE *fte;
+	uint8_t *kpage;
+
+	if(pte != NULL && pte->zero && pte->writable)
+	{
+		kpage = frame_alloc(upage, PAL_USER | PAL_ZERO);
+		if(kpage == NULL)
+			return false;
+		/* the clock passes over the new frame as long as UPAGE
+		   maps the zero frame, and may take it as soon as UPAGE
+		   maps it, so the PTE is made to match meanwhile */
+		sema_down(&frame_sema);
+		pagedir_clear_page(t->pagedir, upage);
+		ASSERT(pagedir_set_page(t->pagedir, upage, kpage, true));
+		pte->paddr = (uint32_t *)kpage;
+		pte->zero = false;
+		pte->cow = false;
+		sema_up(&frame_sema);
+		return true;
+	}
+
+	if(pte == NULL || !pte->cow)
+		return false;
+
+	sema_down(&frame_sema);
+	fte = pte->paddr != NULL ? frame_fte_lookup(pte->paddr) : NULL;
+	if(fte != NULL && fte->refcnt == 1)
+	{
+		frame_file_remove(fte);
+		pagedir_clear_page(t->pagedir, upage);
+		ASSERT(pagedir_set_page(t->pagedir, upage, fte->paddr, true));
+		pte->cow = false;
+		sema_up(&frame_sema);
+		return true;
+	}
+	sema_up(&frame_sema);
+
+	kpage = frame_alloc(upage, PAL_USER);
+	if(kpage == NULL)
+		return false;
+
+	sema_down(&frame_sema);
+	fte = pte->paddr != NULL ? frame_fte_lookup(pte->paddr) : NULL;
+	if(fte == NULL)
+	{
+		/* evicted meanwhile; the write faults again and loads it */
+		sema_up(&frame_sema);
+		frame_remove_fte((uint32_t *)kpage);
+		return true;
+	}
+	memcpy(kpage, fte->paddr, PGSIZE);
+	frame_unmap(fte, t);
+	ASSERT(pagedir_set_page(t->pagedir, upage, kpage, true));
+	pte->paddr = (uint32_t *)kpage;
+	pte->cow = false;
+	sema_up(&frame_sema);
 	return true;
 }
 
@@ -104,9 +413,14 @@ void page_map(uint32_t *upage, uint32_t *kpage, bool writable)
 	new_pte->uaddr = upage;
 	new_pte->dirty = false;
 	new_pte->is_swapped_out = false;
+	new_pte->in_transit = false;
 	new_pte->writable = writable;
 	new_pte->usertid = t->tid;
+	new_pte->owner = t;
 	new_pte->load = false;
+	new_pte->cow = false;
+	new_pte->mmap = false;
+	new_pte->zero = false;
 
 	new_pte->file = NULL;
 	new_pte->ofs = -1;
@@ -114,7 +428,7 @@ void page_map(uint32_t *upage, uint32_t *kpage, bool writable)
 	new_pte->page_zero_bytes = -1;
 	new_pte->load_result = false;
 
-	hash_insert(&t->pt, &new_pte->helem);
+	page_insert(new_pte);
 	
 
 	// sema_up(&page_sema);
@@ -125,97 +439,202 @@ void page_remove_pte(uint32_t *upage)
 	if(upage==NULL) return;
 
 	// sema_down(&page_sema);
-	PTE *pte = page_pte_lookup(upage);
-	hash_delete(&thread_current()->pt, &pte->helem);
-	free(pte);
+	PTE **slot = page_slot(thread_current(), upage, false);
+	if(slot != NULL && *slot != NULL)
+	{
+		free(*slot);
+		*slot = NULL;
+	}
 	// sema_up(&page_sema);
 }
 
 PTE* page_pte_lookup(uint32_t *addr)
 {
-	PTE pte;
-	struct hash_elem *helem;
-	pte.uaddr = addr;
-	helem = hash_find(&thread_current()->pt, &pte.helem);
-	return helem!=NULL ? hash_entry(helem, PTE, helem) : NULL;
+	return page_thread_lookup(addr, thread_current());
 }
 
-PTE* parent_page_lookup(uint32_t* uaddr, struct thread* parent)
+/* Returns the current thread's page table entry for UPAGE. If it
+   has none yet but UPAGE lies in a VMA, the entry is created as
+   a lazily loaded page of that VMA. Returns NULL otherwise. */
+PTE* page_pte_get(uint32_t *upage)
 {
-	PTE finding;
-	struct hash_elem *helem;
-	finding.uaddr = uaddr;
-	helem = hash_find(&parent->pt, &finding.helem);
-	ASSERT(helem != NULL);
-	PTE *pte = hash_entry(helem, PTE, helem);
+	PTE *pte = page_pte_lookup(upage);
+	if(pte != NULL)
+		return pte;
+
+	VMA *vma = page_vma_lookup(upage);
+	if(vma == NULL)
+		return NULL;
+
+	off_t page_ofs = (uint8_t *)upage - vma->start;
+	size_t page_read_bytes = 0;
+	if(vma->read_bytes > (uint32_t)page_ofs)
+		page_read_bytes = vma->read_bytes - page_ofs < PGSIZE ? vma->read_bytes - page_ofs : PGSIZE;
+
+	if(!lazy_load(upage, vma->file, vma->ofs + page_ofs, page_read_bytes,
+		PGSIZE - page_read_bytes, vma->writable))
+		return NULL;
+	pte = page_pte_lookup(upage);
+	pte->mmap = vma->mmap;
 	return pte;
 }
 
-void page_clear_all(void)
+/* Adds a VMA of READ_BYTES + ZERO_BYTES bytes at START, whose
+   pages are loaded from FILE at OFS on first touch, to the
+   current thread. */
+bool page_add_vma(uint8_t *start, struct file *file, off_t ofs, uint32_t read_bytes, uint32_t zero_bytes, bool writable, bool mmap)
 {
-	struct hash* page_table = &(thread_current()->pt);
-	struct hash* swap_table = &(thread_current()->st);
-	ASSERT(page_table != NULL);
-	ASSERT(swap_table != NULL);
-
-	// printf("CLEAR START TID : %d\n", thread_current()->tid);
-	// if(!strcmp(thread_current()->exec, "child-syn-wrt") )
-		// return;
-	struct list del_list;
-	list_init(&del_list);
+	ASSERT(pg_ofs(start) == 0);
+	ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
 
-	struct hash_iterator i;
-	// printf("HERE\n");
-	hash_first(&i, page_table);
-	// printf("HERE HERE\n");
-	// printf("THREAD TID : %d\n ", thread_current()->tid);
-	// sema_down(&page_table);
+	VMA *vma = (VMA*)malloc(sizeof(VMA));
+	if(vma == NULL)
+		return false;
+	vma->start = start;
+	vma->end = start + read_bytes + zero_bytes;
+	vma->file = file;
+	vma->ofs = ofs;
+	vma->read_bytes = read_bytes;
+	vma->writable = writable;
+	vma->mmap = mmap;
+	list_push_back(&thread_current()->vma_list, &vma->elem);
+	return true;
+}
 
+/* Returns the current thread's VMA that contains UPAGE, or NULL. */
+VMA* page_vma_lookup(uint32_t *upage)
+{
+	struct list *vmas = &thread_current()->vma_list;
+	struct list_elem *e;
 
-	while(hash_next(&i))
+	for(e = list_begin(vmas); e != list_end(vmas); e = list_next(e))
 	{
-		PTE *pte = hash_entry(hash_cur(&i), PTE, helem);
-		list_push_back(&del_list, &pte->elem);
-		
-		// printf("UADDR : %p\n", pte->uaddr);
+		VMA *vma = list_entry(e, VMA, elem);
+		if(vma->start <= (uint8_t *)upage && (uint8_t *)upage < vma->end)
+			return vma;
 	}
+	return NULL;
+}
 
-	
-	struct list_elem *del_elem;
-	struct swap_table_entry* ste = NULL;
-
-	while(!list_empty(&del_list))
-	{
+/* Returns true if [START, END) overlaps one of the current
+   thread's VMAs. */
+bool page_vma_overlaps(uint8_t *start, uint8_t *end)
+{
+	struct list *vmas = &thread_current()->vma_list;
+	struct list_elem *e;
+	uintptr_t pde;
 
-		del_elem = list_pop_front(&del_list);
+	/* 4 MB pages from page_map_large() count as areas too */
+	for(pde = pd_no(start); start < end && pde <= pd_no(end - 1); pde++)
+		if(pde < pd_no(PHYS_BASE)
+			&& pagedir_is_large(thread_current()->pagedir, (void *)(pde << PDSHIFT)))
+			return true;
 
-		PTE *pte = list_entry(del_elem, PTE, elem);
-		// sema_up(&swap_sema);
-		frame_remove_fte(pte->paddr);
-		swap_remove_ste(pte->uaddr);
-		page_remove_pte(pte->uaddr);		
-		// sema_up(&swap_sema);
+	for(e = list_begin(vmas); e != list_end(vmas); e = list_next(e))
+	{
+		VMA *vma = list_entry(e, VMA, elem);
+		if(start < vma->end && vma->start < end)
+			return true;
 	}
+	return false;
+}
 
-	
-	// free(swap_table->buckets);
-	hash_destroy(swap_table, NULL);
-	hash_destroy(page_table, NULL);
-	// sema_up(&page_table);
-	// printf("CLEAR END\n");
+/* Removes the current thread's VMA that starts at START. Its
+   pages must have been removed already. */
+void page_remove_vma(uint8_t *start)
+{
+	VMA *vma = page_vma_lookup((uint32_t *)start);
+	if(vma == NULL)
+		return;
+	list_remove(&vma->elem);
+	free(vma);
 }
 
+/* Returns thread T's page table entry for UADDR, or NULL. */
+PTE* page_thread_lookup(uint32_t* uaddr, struct thread* t)
+{
+	PTE **slot = page_slot(t, uaddr, false);
+	return slot!=NULL ? *slot : NULL;
+}
 
-unsigned page_hash_hash_helper(const struct hash_elem * element, void * aux)
+/* Returns the number of T's pages that are in memory. */
+size_t page_rss(struct thread *t)
 {
-	PTE *pte = hash_entry(element, PTE, helem);
-	return hash_bytes(&pte->uaddr, sizeof(uint32_t));
+	size_t pde, i, cnt = 0;
+
+	if(t->pt == NULL)
+		return 0;
+	for(pde = 0; pde < pd_no(PHYS_BASE); pde++)
+	{
+		PTE **table = t->pt[pde];
+		if(table == NULL)
+			continue;
+		for(i = 0; i < SPT_CNT; i++)
+			if(table[i] != NULL && table[i]->paddr != NULL && !table[i]->zero)
+				cnt++;
+	}
+	return cnt;
 }
 
-bool page_hash_less_helper(const struct hash_elem *a, const struct hash_elem *b, void *aux)
+/* Releases the whole address space of the exiting process in
+   one walk over its supplemental page table: all of its frames
+   under frame_sema, then all of its swap slots at once, with no
+   per-page lookups. frame_sema is only let go to wait for a page
+   in transit, which is being written out by another thread. */
+void page_clear_all(void)
 {
-	uint32_t* a_key = hash_entry(a, PTE, helem) -> uaddr;
-	uint32_t* b_key = hash_entry(b, PTE, helem) -> uaddr;
-	if(a_key < b_key) return true;
-	else return false;
+	struct thread *t = thread_current();
+	size_t pde, i;
+
+	/* run on the kernel-only page directory meanwhile, so that
+	   unmapping each page does not flush the TLB */
+	pagedir_activate(NULL);
+
+	// printf("CLEAR START TID : %d\n", thread_current()->tid);
+	if(t->pt != NULL)
+	{
+		sema_down(&frame_sema);
+		for(pde = 0; pde < pd_no(PHYS_BASE); pde++)
+		{
+			PTE **table = t->pt[pde];
+			if(table == NULL)
+				continue;
+			for(i = 0; i < SPT_CNT; i++)
+			{
+				PTE *pte = table[i];
+				if(pte == NULL)
+					continue;
+				if(pte->in_transit)
+				{
+					sema_up(&frame_sema);
+					swap_transit_wait(pte);
+					sema_down(&frame_sema);
+				}
+				if(pte->zero)
+					/* or pagedir_destroy() would free the zero frame */
+					pagedir_clear_page(t->pagedir, pte->uaddr);
+				else if(pte->paddr != NULL)
+				{
+					FTE *fte = frame_fte_lookup(pte->paddr);
+					if(fte != NULL)
+						frame_unmap(fte, t);
+				}
+				free(pte);
+			}
+		}
+		sema_up(&frame_sema);
+
+		/* no frame refers to the tables anymore */
+		for(pde = 0; pde < pd_no(PHYS_BASE); pde++)
+			if(t->pt[pde] != NULL)
+				palloc_free_page(t->pt[pde]);
+		palloc_free_page(t->pt);
+		t->pt = NULL;
+	}
+
+	swap_clear_all(t);
+
+	while(!list_empty(&t->vma_list))
+		free(list_entry(list_pop_front(&t->vma_list), VMA, elem));
+	// printf("CLEAR END\n");
 }
\ No newline at end of file
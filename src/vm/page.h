@@ -20,10 +20,15 @@ typedef struct page_table_entry
 	uint32_t *paddr;          /* physical address of the page */
 
 	int usertid;              /* process tid that use this frame */
+	struct thread *owner;     /* process that use this page */
 	bool is_swapped_out;      /* flag for swapped out */
+	bool in_transit;          /* being evicted; faults wait for it */
 	bool dirty;               /* dirty bit flag UNUSED */
 	bool writable;            /* writable flag */
 	bool load;				  /* for load segment page UNUSED*/
+	bool cow;                 /* mapped read-only until written */
+	bool mmap;                /* memory-mapped file page */
+	bool zero;                /* mapped to the shared zero frame */
 
 	/* Lazy Loading */
 	struct file *file;        /* loading file */
@@ -32,26 +37,52 @@ typedef struct page_table_entry
 	size_t page_zero_bytes;   /* zero bytes */
 	bool load_result;         /* actually loaded */
 
-	struct hash_elem helem;   /* hash element */
-	struct list_elem elem;    /* list element */
+	struct list_elem selem;   /* element in sharers of the frame */
 } PTE;
 
+/* A range of lazily loaded pages, such as a segment of the
+   executable or a memory-mapped file, described once. Page I of
+   the range holds the bytes of FILE at OFS + I*PGSIZE, up to
+   READ_BYTES in total, and zeros after them. */
+typedef struct vm_area
+{
+	uint8_t *start;           /* first page */
+	uint8_t *end;             /* end of the last page */
+	struct file *file;        /* file the pages come from */
+	off_t ofs;                /* file offset of the first page */
+	uint32_t read_bytes;      /* bytes read from the file */
+	bool writable;            /* writable flag */
+	bool mmap;                /* memory-mapped file */
+
+	struct list_elem elem;    /* element in vma_list */
+} VMA;
+
 // struct hash page_table;       /* page table */
 
 struct semaphore page_sema;   /* page semaphore */
 
 
 void page_init(void);
+bool page_zero_map(uint32_t *upage);
+void page_fault_around(uint32_t *upage);
+bool page_map_large(uint8_t *upage);
 void page_clear_all(void);
+size_t page_rss(struct thread *t);
 bool lazy_load(uint32_t *upage, struct file *file, off_t ofs, size_t page_read_bytes, size_t page_zero_bytes, bool writable);
 bool actual_load(uint32_t *upage);
+bool page_share(uint32_t *upage);
+bool page_cow(uint32_t *upage);
+void page_unmap(uint32_t *upage);
 void page_map(uint32_t *upage, uint32_t *kpage, bool writable);
 void page_remove_pte(uint32_t *upage);
 PTE* page_pte_lookup(uint32_t *addr);
-void page_table_init(struct hash* h);
-PTE* parent_page_lookup(uint32_t* uaddr, struct thread* parent);
-unsigned page_hash_hash_helper(const struct hash_elem * element, void * aux);
-bool page_hash_less_helper(const struct hash_elem *a, const struct hash_elem *b, void *aux);
+PTE* page_pte_get(uint32_t *upage);
+bool page_add_vma(uint8_t *start, struct file *file, off_t ofs, uint32_t read_bytes, uint32_t zero_bytes, bool writable, bool mmap);
+VMA* page_vma_lookup(uint32_t *upage);
+bool page_vma_overlaps(uint8_t *start, uint8_t *end);
+void page_remove_vma(uint8_t *start);
+void page_table_init(struct thread *t);
+PTE* page_thread_lookup(uint32_t* uaddr, struct thread* t);
 
 
 #endif /* vm/page.h */
\ No newline at end of file
@@ -1,14 +1,58 @@
 #include "vm/swap.h"
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "filesys/file.h"
 #include "vm/frame.h"
 #include "vm/page.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+#include <string.h>
+
+/* Swap space is divided into slots of SWAP_STRIPE sectors (one
+   page) each, and striped across up to SWAP_DISK_MAX disks by
+   slot, so that consecutive slots land on different disks and,
+   when those disks sit on different channels, are transferred in
+   parallel. A page always sits in one slot, contiguous on one
+   disk. */
+#define SWAP_DISK_MAX 4
+#define SWAP_STRIPE 8
+#define SWAP_CLUSTER 8   /* pages moved together on swap-in/out */
+
+static int swap_disk_no[SWAP_DISK_MAX][2];    /* configured (channel, device) */
+static int swap_disk_conf = 0;                /* number of configured disks */
+static struct disk *swap_disks[SWAP_DISK_MAX];/* swap disks in stripe order */
+static int swap_disk_cnt = 0;                 /* number of swap disks */
+
+static int *swap_free_slots;                  /* stack of free slots */
+static size_t swap_free_cnt;                  /* number of free slots */
+static size_t swap_slot_cnt;                  /* number of slots */
+static size_t swap_peak;                      /* most slots ever in use */
+
+/* A page being evicted is marked in transit from before it is
+   unmapped until its frame is freed, and a page being cleaned
+   while its write lasts. The mark is set with frame_sema held,
+   and keeps other evictions off the page. A fault on it, or the
+   exit or munmap that would free it, waits on transit_cond
+   meanwhile. */
+static struct lock transit_lock;
+static struct condition transit_cond;
+static int transit_cnt;                       /* pages in transit */
+static unsigned transit_ends;                 /* transits ended so far */
 
 unsigned swap_hash_hash_helper(const struct hash_elem * element, void * aux);
 bool swap_hash_less_helper(const struct hash_elem *a, const struct hash_elem *b, void *aux);
+static bool swap_unmap_page(FTE *fte, PTE *pte);
+static STE* swap_find(struct hash *st, uint32_t *addr);
+static bool swap_zstore(STE *ste, void *kpage);
+static bool swap_zero(STE *ste, void *kpage);
+static bool swap_read_page(STE *ste, void *kpage, struct disk_request *r);
+static void swap_submit_page(STE *ste, void *kpage, bool write, struct disk_request *r);
 
 void swap_init(void)
 {
 	sema_init(&swap_sema, 1);
+	lock_init(&transit_lock);
+	cond_init(&transit_cond);
 	// printf("SEMA VALUE : %d\n", swap_sema.value);
 
 	// sema_down(&swap_sema);
@@ -16,47 +60,177 @@ void swap_init(void)
 	// sema_up(&swap_sema);
 }
 
-void swap_table_init(struct hash* h)
+/* Initializes T's swap table. Evicting threads add entries to it
+   on T's behalf, so every access takes T's st_lock. */
+void swap_table_init(struct thread *t)
 {
-	if(h == NULL) return;
-	// sema_down(&swap_sema);
-  	hash_init(h, swap_hash_hash_helper, swap_hash_less_helper, NULL);
-  	// sema_up(&swap_sema);
+	lock_init(&t->st_lock);
+  	hash_init(&t->st, swap_hash_hash_helper, swap_hash_less_helper, NULL);
 }
 
+/* Adds disk DEV_NO on channel CHAN_NO to the swap disks. Must be
+   called before swapdisk_bitmap_init(). Without any, hd1:1 is
+   used. */
+void swap_add_disk(int chan_no, int dev_no)
+{
+	if(swap_disk_conf == SWAP_DISK_MAX)
+		PANIC("swap: too many swap disks");
+	swap_disk_no[swap_disk_conf][0] = chan_no;
+	swap_disk_no[swap_disk_conf][1] = dev_no;
+	swap_disk_conf++;
+}
+
+/* Finds the swap disks, which must be detected already, and
+   creates the slot map over all of them. Every disk gives the
+   same number of slots, set by the smallest. */
 void swapdisk_bitmap_init(void)
 {
-	swapdisk_bitmap = bitmap_create(8064);
+	disk_sector_t per_disk = 0;
+	int i;
+
+	if(swap_disk_conf == 0)
+		swap_add_disk(1, 1);
+
+	for(i = 0; i < swap_disk_conf; i++)
+	{
+		struct disk *d = disk_get(swap_disk_no[i][0], swap_disk_no[i][1]);
+		if(d == NULL)
+		{
+			printf("swap: no disk hd%d:%d\n", swap_disk_no[i][0], swap_disk_no[i][1]);
+			continue;
+		}
+		if(swap_disk_cnt == 0 || disk_size(d) < per_disk)
+			per_disk = disk_size(d);
+		swap_disks[swap_disk_cnt++] = d;
+	}
+	size_t slot_cnt = per_disk / SWAP_STRIPE * swap_disk_cnt;
+	swap_slot_cnt = slot_cnt;
+
+	swapdisk_bitmap = bitmap_create(slot_cnt);
+	swap_free_slots = malloc(slot_cnt * sizeof *swap_free_slots);
+	if(swapdisk_bitmap == NULL || (swap_free_slots == NULL && slot_cnt > 0))
+		PANIC("swap: slot map creation failed");
+
+	/* lowest slot on top, so slots are handed out in order */
+	for(swap_free_cnt = 0; swap_free_cnt < slot_cnt; swap_free_cnt++)
+		swap_free_slots[swap_free_cnt] = slot_cnt - 1 - swap_free_cnt;
 }
 
-STE* swap_set_ste(uint32_t *upage)
+/* Takes a free swap slot off the stack, or panics if swap is
+   full. */
+static int swap_slot_alloc(void)
 {
-	struct thread *t = thread_current();
-	// sema_down(&swap_sema);
-	STE* new_ste = (STE*)malloc(sizeof(STE));
-	new_ste->uaddr = upage;
-	int i=0;
-	for(; i<8; i++) new_ste->sec_no[i] = -1;
+	int slot;
+
+	sema_down(&swap_sema);
+	if(swap_free_cnt == 0)
+		PANIC("swap: out of swap slots");
+	slot = swap_free_slots[--swap_free_cnt];
+	ASSERT(!bitmap_test(swapdisk_bitmap, slot));
+	bitmap_mark(swapdisk_bitmap, slot);
+	if(swap_slot_cnt - swap_free_cnt > swap_peak)
+		swap_peak = swap_slot_cnt - swap_free_cnt;
+	sema_up(&swap_sema);
+
+	return slot;
+}
 
-	hash_insert(&t->st, &new_ste->helem);
-	
-	// sema_up(&swap_sema);
+/* Puts SLOT back on the free stack. swap_sema must be held. */
+static void swap_slot_release(int slot)
+{
+	ASSERT(bitmap_test(swapdisk_bitmap, slot));
+	bitmap_reset(swapdisk_bitmap, slot);
+	swap_free_slots[swap_free_cnt++] = slot;
+}
 
+/* Puts SLOT back on the free stack. */
+static void swap_slot_free(int slot)
+{
+	sema_down(&swap_sema);
+	swap_slot_release(slot);
+	sema_up(&swap_sema);
+}
 
+static void swap_ste_destroy(struct hash_elem *helem, void *aux)
+{
+	free(hash_entry(helem, STE, helem));
+}
 
-	return new_ste;
+/* Frees all of T's swap slots, under a single acquisition of
+   swap_sema, and then its whole swap table. None of T's pages
+   may be in the frame table anymore. */
+void swap_clear_all(struct thread *t)
+{
+	struct hash_iterator i;
+
+	lock_acquire(&t->st_lock);
+	sema_down(&swap_sema);
+	hash_first(&i, &t->st);
+	while(hash_next(&i))
+	{
+		STE *ste = hash_entry(hash_cur(&i), STE, helem);
+		if(ste->slot != -1)
+			swap_slot_release(ste->slot);
+		if(ste->zofs != -1)
+			zswap_free(ste->zofs, ste->zlen);
+	}
+	sema_up(&swap_sema);
+
+	hash_destroy(&t->st, swap_ste_destroy);
+	lock_release(&t->st_lock);
+}
+
+/* Fills in the swap part of ST. Free slots are counted in runs
+   of contiguous slots, which tells how fragmented swap is: only
+   neighbouring slots are merged into one transfer on swap-out. */
+void swap_vmstat(struct vmstat *st)
+{
+	size_t slot;
+	int runs = 0;
+
+	sema_down(&swap_sema);
+	for(slot = 0; slot < swap_slot_cnt; slot++)
+		if(!bitmap_test(swapdisk_bitmap, slot)
+			&& (slot == 0 || bitmap_test(swapdisk_bitmap, slot - 1)))
+			runs++;
+	st->swap_slots = swap_slot_cnt;
+	st->swap_used = swap_slot_cnt - swap_free_cnt;
+	st->swap_peak = swap_peak;
+	st->swap_free_runs = runs;
+	sema_up(&swap_sema);
+
+	zswap_vmstat(st);
 }
 
+/* Returns the swap disk holding swap slot SLOT and stores the
+   number of the slot's first sector on that disk into
+   *DISK_SEC. */
+static struct disk *swap_locate(int slot, disk_sector_t *disk_sec)
+{
+	*disk_sec = (slot / swap_disk_cnt) * SWAP_STRIPE;
+	return swap_disks[slot % swap_disk_cnt];
+}
 
-STE* parent_swap_set(uint32_t* upage, struct thread * parent)
+STE* swap_set_ste(uint32_t *upage)
+{
+	return swap_thread_set(upage, thread_current());
+}
+
+/* Adds an empty swap table entry for UPAGE to thread T. */
+STE* swap_thread_set(uint32_t* upage, struct thread * t)
 {
 
 	// sema_down(&swap_sema);
 	STE* ste = (STE*)malloc(sizeof(STE));
+	if(ste == NULL)
+		PANIC("swap: out of memory for swap table entries");
 	ste->uaddr = upage;
-	int i=0;
-	for(; i<8; i++) ste->sec_no[i] = -1;
-	hash_insert(&parent->st, &ste->helem);
+	ste->slot = -1;
+	ste->zofs = -1;
+	ste->zero = false;
+	lock_acquire(&t->st_lock);
+	hash_insert(&t->st, &ste->helem);
+	lock_release(&t->st_lock);
 	// sema_up(&swap_sema);
 
 	return ste;
@@ -64,6 +238,8 @@ STE* parent_swap_set(uint32_t* upage, struct thread * parent)
 
 
 
+/* Removes the swap table entry for UPAGE, if any, and frees its
+   swap slot. */
 void swap_remove_ste(uint32_t* upage)
 {
 	// sema_down(&swap_sema);
@@ -73,9 +249,17 @@ void swap_remove_ste(uint32_t* upage)
 
 	
 	// printf("UPAGE : %p\n", upage);
-	STE* ste = swap_ste_lookup(upage);
-	if(ste != NULL) {
+	lock_acquire(&t->st_lock);
+	STE* ste = swap_find(&t->st, upage);
+	if(ste != NULL)
 		hash_delete(&t->st, &ste->helem);
+	lock_release(&t->st_lock);
+
+	if(ste != NULL) {
+		if(ste->slot != -1)
+			swap_slot_free(ste->slot);
+		if(ste->zofs != -1)
+			zswap_free(ste->zofs, ste->zlen);
 		free(ste);
 	}
 
@@ -84,142 +268,454 @@ void swap_remove_ste(uint32_t* upage)
 
 
 STE* swap_ste_lookup(uint32_t *addr)
+{
+	return swap_thread_lookup(addr, thread_current());
+}
+
+/* Returns the entry for ADDR in swap table ST, or NULL. The
+   table's owner's st_lock must be held. */
+static STE* swap_find(struct hash *st, uint32_t *addr)
 {
 	STE ste;
 	struct hash_elem *helem;
-	struct thread *t = thread_current();
 
 	ste.uaddr = addr;
-	helem = hash_find(&t->st, &ste.helem);
+	helem = hash_find(st, &ste.helem);
 
 	return helem!=NULL ? hash_entry(helem, STE, helem) : NULL;
 }
 
+/* Returns thread T's swap table entry for ADDR, or NULL. Only T
+   frees its entries, so the one returned stays valid. */
+STE* swap_thread_lookup(uint32_t *addr, struct thread *t)
+{
+	STE *ste;
+
+	lock_acquire(&t->st_lock);
+	ste = swap_find(&t->st, addr);
+	lock_release(&t->st_lock);
+	return ste;
+}
+
+/* Brings the page at UADDR back from swap. Up to SWAP_CLUSTER-1
+   of the pages that follow it and are swapped out too are read
+   along with it, as long as free frames are left, so that a
+   sequential scan over swapped memory pays for one round of
+   disk requests per cluster instead of one per page. */
 bool swap_in(uint32_t *uaddr)
 {
+	struct thread *t = thread_current();
+	struct disk_request req[SWAP_CLUSTER];
+	uint8_t *upage[SWAP_CLUSTER], *kpage[SWAP_CLUSTER];
+	bool read[SWAP_CLUSTER];
 	PTE *pte = page_pte_lookup(uaddr);
 	STE *ste = swap_ste_lookup(uaddr);
-	uint8_t *paddr = NULL;
+	int64_t start;
+	int i, n = 0;
 	// printf("SWAP IN COME\n");
 	ASSERT(pte->uaddr == uaddr);
 
 	/* add to frame table */
-	paddr = frame_get_fte(uaddr, PAL_USER | PAL_ZERO);
+	kpage[0] = frame_alloc(uaddr, PAL_USER | PAL_ZERO);
 
-	if(paddr == NULL) return false;
+	if(kpage[0] == NULL) return false;
+	upage[0] = (uint8_t *)uaddr;
 
 	/* put data to physical memory */
 	// printf("SWAP IN BEFORE : %d\n", swap_sema.value);
 	// sema_down(&swap_sema);
-	int i=0;
-	for(; i<8; i++)
+	start = timer_ticks();
+	read[n] = swap_read_page(ste, kpage[0], &req[n]);
+	n++;
+
+	/* prefetch */
+	for(; n < SWAP_CLUSTER; n++)
 	{
-		ASSERT(ste->sec_no[i] != -1);
-		disk_read(disk_get(1,1), ste->sec_no[i], paddr + i*512);
-		bitmap_set(swapdisk_bitmap, ste->sec_no[i], false);
+		uint8_t *up = upage[0] + n*PGSIZE;
+		if(!is_user_vaddr(up))
+			break;
+		PTE *p = page_pte_lookup((uint32_t *)up);
+		STE *s = swap_ste_lookup((uint32_t *)up);
+		if(p == NULL || !p->is_swapped_out || p->in_transit || s == NULL)
+			break;
+		/* not at the cost of pages still in use */
+		if(frame_over_limit(t))
+			break;
+		uint8_t *kp = frame_get_fte((uint32_t *)up, PAL_USER);
+		if(kp == NULL)
+			break;
+		upage[n] = up;
+		kpage[n] = kp;
+		read[n] = swap_read_page(s, kp, &req[n]);
 	}
-	
 
-	/* install page */
-	ASSERT(pagedir_get_page(thread_current()->pagedir, uaddr) == NULL);
-	ASSERT(pagedir_set_page(thread_current()->pagedir, uaddr, paddr, true));
+	for(i = 0; i < n; i++)
+	{
+		if(read[i])
+		{
+			disk_wait(&req[i]);
+			vm_stat.pageins++;
+		}
 
-	/* update mapping info in page table*/
-	pte->paddr = paddr;
-	pte->is_swapped_out = false;
+		/* install page */
+		ASSERT(pagedir_get_page(t->pagedir, upage[i]) == NULL);
+		ASSERT(pagedir_set_page(t->pagedir, upage[i], kpage[i], true));
 
-	/* erase info from swap table */
+		/* update mapping info in page table*/
+		pte = page_pte_lookup((uint32_t *)upage[i]);
+		pte->paddr = (uint32_t *)kpage[i];
+		pte->is_swapped_out = false;
+	}
+	vm_stat.swap_read_ticks += timer_elapsed(start);
+
+	/* keep the swap slot: while the page stays clean, it need not
+	   be written again when it is evicted next time */
 	// sema_up(&swap_sema);
 	// printf("SWAP IN AFTER : %d\n", swap_sema.value);
-	swap_remove_ste(uaddr);
 	
 
 	return true;
 }
 
-bool swap_out(uint32_t *uaddr)
+/* Evicts the page in frame FTE on behalf of the frame's owner,
+   which need not be the running thread. Along with it go up to
+   SWAP_CLUSTER-1 of the pages that follow it in the owner's
+   address space, as long as they are resident, not accessed
+   recently and dirty. Their writes are all submitted before any
+   is waited for, so the disk merges pages in neighbouring slots
+   into one sequential run. With -zswap, a page that compresses
+   well goes to the zswap pool instead and is not written at all.
+
+   The pages are unmapped and put in transit with frame_sema
+   held, which is then released for the writes, so that other
+   faults need not wait for them. The frames are freed once it is
+   held again. Must be called with frame_sema held. */
+bool swap_out(FTE *fte)
 {	
-	
-	PTE *pte = page_pte_lookup(uaddr);
-	
-	/* Put to swap table */
-	STE *ste = swap_set_ste(uaddr);
-	// printf("SWAP OUT BEFORE : %d\n", swap_sema.value);
-	// sema_down(&swap_sema);
-	/* disk get */
-	int i = 0, cnt = 0;
-	while(cnt<8)
+	struct thread *t = fte->owner;
+	struct disk_request req[SWAP_CLUSTER];
+	FTE *cluster[SWAP_CLUSTER];
+	PTE *pte[SWAP_CLUSTER];
+	bool write[SWAP_CLUSTER], submit[SWAP_CLUSTER];
+	int64_t start;
+	int i, n = 0;
+
+	cluster[n++] = fte;
+	for(; n < SWAP_CLUSTER; n++)
 	{
-		if(!bitmap_test(swapdisk_bitmap, i))
-			ste->sec_no[cnt++] = i;
-		i++;
+		uint8_t *up = (uint8_t *)fte->uaddr + n*PGSIZE;
+		if(!is_user_vaddr(up) || pagedir_get_page(t->pagedir, up) == NULL)
+			break;
+		if(pagedir_is_accessed(t->pagedir, up) || !pagedir_is_dirty(t->pagedir, up))
+			break;
+		PTE *p = page_thread_lookup((uint32_t *)up, t);
+		FTE *f = p != NULL && !p->in_transit ? frame_fte_lookup(p->paddr) : NULL;
+		if(f == NULL || f->owner != t || f->uaddr != (uint32_t *)up)
+			break;
+		cluster[n] = f;
 	}
 
-	/* pte->is_swapped_out = true */
-	pte->is_swapped_out = true;
+	for(i = 0; i < n; i++)
+	{
+		pte[i] = page_thread_lookup(cluster[i]->uaddr, t);
+		write[i] = swap_unmap_page(cluster[i], pte[i]);
+		/* no one may map the frame from the page cache meanwhile */
+		frame_file_remove(cluster[i]);
+	}
+	sema_up(&frame_sema);
 
-	/* store file data to disk */
-	// sema_down(&swap_sema);
-	i=0;
-	for(; i<8; i++)
+	start = timer_ticks();
+	for(i = 0; i < n; i++)
 	{
-		ASSERT(ste->sec_no[i] != -1);
-		disk_write(disk_get(1,1), ste->sec_no[i], pte->paddr + i*512/4);
-		bitmap_set(swapdisk_bitmap, ste->sec_no[i], true);
+		submit[i] = false;
+		if(!write[i] || pte[i]->mmap)
+			continue;
+		STE *ste = swap_thread_lookup(cluster[i]->uaddr, t);
+		if(swap_zero(ste, cluster[i]->paddr) || swap_zstore(ste, cluster[i]->paddr))
+			continue;
+		/* incompressible, or the pool is full */
+		if(ste->slot == -1)
+			ste->slot = swap_slot_alloc();
+		swap_submit_page(ste, cluster[i]->paddr, true, &req[i]);
+		submit[i] = true;
 	}
-	// sema_up(&swap_sema);
 
-	// sema_up(&swap_sema);
-	// printf("SWAP OUT AFTER : %d\n", swap_sema.value);
-	/* remvoe from frame table */
-	frame_remove_fte(pte->paddr);
+	/* memory-mapped pages go back to their file, on the file
+	   system disk's channel, while the swap writes are under way
+	   on the swap disks' */
+	for(i = 0; i < n; i++)
+		if(write[i] && pte[i]->mmap)
+		{
+			file_write_at(pte[i]->file, cluster[i]->paddr, pte[i]->page_read_bytes, pte[i]->ofs);
+			vm_stat.writebacks++;
+		}
+
+	for(i = 0; i < n; i++)
+		if(submit[i])
+		{
+			disk_wait(&req[i]);
+			vm_stat.pageouts++;
+		}
+	vm_stat.swap_write_ticks += timer_elapsed(start);
+
+	sema_down(&frame_sema);
+	for(i = 0; i < n; i++)
+	{
+		/* remvoe from frame table */
+		frame_free_fte(cluster[i]);
+		swap_transit_end(pte[i]);
+	}
 	
 	return true;	
 }
 
-void swap_parent(uint32_t* uaddr){
-	/* page_pte_lookup*/
-	// printf("swap parent entered\n");
-	
-	struct thread* parent = thread_current()->parent;
-	PTE* pte = parent_page_lookup(uaddr,parent);
-	STE* ste = parent_swap_set(uaddr, parent);
-	/* swap_ste_lookup*/
-	// printf("pass 1\n");
-	/* disk get */
-	// printf("PARENT VALUE BEFORE : %d\n", swap_sema.value);
-	// sema_down(&swap_sema);
-	int i = 0, cnt = 0;
+/* Writes the dirty page in frame FTE out ahead of its eviction,
+   to its file if it is memory-mapped and to a swap slot
+   otherwise, and leaves it resident. Its dirty bit is cleared
+   before the write, so a write to the page meanwhile makes it
+   dirty again and its eviction writes it anew; while it stays
+   clean, its eviction just drops it. The page is in transit
+   while it is written. Must be called with frame_sema held,
+   which is released for the write. */
+bool swap_clean(FTE *fte)
+{
+	struct thread *t = fte->owner;
+	struct disk_request req;
+	PTE *pte = page_thread_lookup(fte->uaddr, t);
+	STE *ste = NULL;
+	ASSERT(pte != NULL && !pte->in_transit && list_empty(&fte->sharers));
+
+	swap_transit_begin(pte);
+	pagedir_set_dirty(t->pagedir, fte->uaddr, false);
+	if(!pte->mmap)
+	{
+		ste = swap_thread_lookup(fte->uaddr, t);
+		if(ste == NULL)
+			ste = swap_thread_set(fte->uaddr, t);
+		if(ste->slot == -1)
+			ste->slot = swap_slot_alloc();
+		/* modified, so from now on the page lives in swap */
+		pte->load = false;
+	}
+	sema_up(&frame_sema);
 
-	while(cnt<8)
+	if(pte->mmap)
 	{
-		if(!bitmap_test(swapdisk_bitmap, i)){
-			ste->sec_no[cnt++] = i;
-		}
-		i++;
+		file_write_at(pte->file, fte->paddr, pte->page_read_bytes, pte->ofs);
+		vm_stat.writebacks++;
+	}
+	else
+	{
+		swap_submit_page(ste, fte->paddr, true, &req);
+		disk_wait(&req);
+		vm_stat.pageouts++;
+	}
+
+	sema_down(&frame_sema);
+	swap_transit_end(pte);
+	return true;
+}
+
+/* Unmaps the page in frame FTE from its owner, whose entry for
+   it is PTE, and marks it as evicted. Only dirty pages need to be
+   written: a clean page loaded from a file is dropped and loaded
+   from the file again on the next fault, and a clean page that
+   still has its swap slot keeps it. Returns true if the page has
+   to be written, back to its file if it is memory-mapped and to
+   its swap table entry otherwise. The page is in transit from
+   before it is unmapped, so a fault on it waits in
+   swap_transit_wait() until the caller calls swap_transit_end().
+   Must be called with frame_sema held. */
+static bool swap_unmap_page(FTE *fte, PTE *pte)
+{
+	struct thread *t = fte->owner;
+	STE *ste = NULL;
+	ASSERT(pte != NULL);
+
+	swap_transit_begin(pte);
+
+	/* a page not backed by a mapped file may have to go to swap;
+	   its entry is made while the page is still mapped */
+	if(!pte->mmap)
+	{
+		ste = swap_thread_lookup(fte->uaddr, t);
+		if(ste == NULL)
+			ste = swap_thread_set(fte->uaddr, t);
 	}
 
-	// printf("pass 2\n");
+	/* a shared frame holds an unmodified file page, which is
+	   dropped from all the processes that map it */
+	while(!list_empty(&fte->sharers))
+	{
+		PTE *p = list_entry(list_pop_front(&fte->sharers), PTE, selem);
+		/* set up for the reload before the page goes away */
+		p->load_result = false;
+		p->paddr = NULL;
+		pagedir_clear_page(p->owner->pagedir, p->uaddr);
+		fte->refcnt--;
+	}
+
+	/* unmap first, so that no write slips in after the dirty bit
+	   is read */
+	pagedir_clear_page(t->pagedir, fte->uaddr);
+	bool dirty = pagedir_is_dirty(t->pagedir, fte->uaddr);
+	pte->paddr = NULL;
+
+	if(pte->mmap)
+	{
+		/* set up to be loaded from the file again before the
+		   caller writes it back there */
+		pte->load_result = false;
+		return dirty;
+	}
+	if(pte->load && !dirty)
+	{
+		/* still the same as in the file */
+		pte->load_result = false;
+		return false;
+	}
+	/* modified, so from now on the page lives in swap */
+	pte->load = false;
+
+	/* a page with no copy in swap, either new or read back from
+	   the zswap pool, has to be stored even if clean; swap_out
+	   finds it a place */
+	if(ste->slot == -1)
+		dirty = true;
+
 	pte->is_swapped_out = true;
 
-	/* store file data to disk */
+	return dirty;
+}
+
+/* Puts PTE's page in transit. Must be called with frame_sema
+   held. */
+void swap_transit_begin(PTE *pte)
+{
+	lock_acquire(&transit_lock);
+	ASSERT(!pte->in_transit);
+	pte->in_transit = true;
+	transit_cnt++;
+	lock_release(&transit_lock);
+}
+
+/* Ends the transit of PTE's page and wakes up the threads
+   waiting for it. */
+void swap_transit_end(PTE *pte)
+{
+	lock_acquire(&transit_lock);
+	pte->in_transit = false;
+	transit_cnt--;
+	transit_ends++;
+	cond_broadcast(&transit_cond, &transit_lock);
+	lock_release(&transit_lock);
+}
+
+/* Waits until the transit of some page ends, which frees its
+   frame or makes it clean. Returns false at once if no page is
+   in transit. */
+bool swap_transit_wait_any(void)
+{
+	unsigned ends;
 
-	i=0;
-	for(; i<8; i++)
+	lock_acquire(&transit_lock);
+	if(transit_cnt == 0)
 	{
-		
-		ASSERT(ste->sec_no[i] != -1);
-		disk_write(disk_get(1,1), ste->sec_no[i], pte->paddr + i*512/4);
-		bitmap_set(swapdisk_bitmap, ste->sec_no[i], true);
+		lock_release(&transit_lock);
+		return false;
 	}
+	ends = transit_ends;
+	while(transit_ends == ends)
+		cond_wait(&transit_cond, &transit_lock);
+	lock_release(&transit_lock);
+	return true;
+}
 
-	// sema_up(&swap_sema);
-	// printf("PARENT VALUE AFTER : %d\n", swap_sema.value);
+/* Waits until PTE's page, if it is in transit, is out or
+   written. */
+void swap_transit_wait(PTE *pte)
+{
+	lock_acquire(&transit_lock);
+	while(pte->in_transit)
+		cond_wait(&transit_cond, &transit_lock);
+	lock_release(&transit_lock);
+}
 
-	/* remvoe from frame table */
-	parent_remove_fte(pte->paddr, parent);
-	
-	// printf("swap parent exited\n");
+/* Reads the page recorded in STE into KPAGE. An all-zero page
+   is just cleared, and a page in the zswap pool is decompressed
+   right away and leaves the pool; otherwise a disk read is
+   started as R and true is returned, and the caller waits for
+   R. */
+static bool swap_read_page(STE *ste, void *kpage, struct disk_request *r)
+{
+	if(ste->zero)
+	{
+		memset(kpage, 0, PGSIZE);
+		ste->zero = false;
+		return false;
+	}
+	if(ste->zofs != -1)
+	{
+		zswap_load(ste->zofs, ste->zlen, kpage);
+		zswap_free(ste->zofs, ste->zlen);
+		ste->zofs = -1;
+		vm_stat.zpageins++;
+		return false;
+	}
+	swap_submit_page(ste, kpage, false, r);
+	return true;
+}
+
+/* Checks whether the page in KPAGE, recorded in STE, is all
+   zeros. Such a page is only marked as such and zeroed again on
+   swap-in, without being stored anywhere; its old copy in a swap
+   slot, if any, is freed. */
+static bool swap_zero(STE *ste, void *kpage)
+{
+	const uint32_t *p = kpage;
+	size_t i;
+
+	for(i = 0; i < PGSIZE / sizeof *p; i++)
+		if(p[i] != 0)
+			return false;
+	if(ste->slot != -1)
+	{
+		swap_slot_free(ste->slot);
+		ste->slot = -1;
+	}
+	ste->zero = true;
+	vm_stat.zero_pageouts++;
+	return true;
+}
+
+/* Tries to keep the page in KPAGE, recorded in STE, compressed
+   in the zswap pool instead of writing it to disk. Its old copy
+   in a swap slot, if any, is stale then and freed. */
+static bool swap_zstore(STE *ste, void *kpage)
+{
+	ASSERT(ste->zofs == -1);
+	if(!zswap_store(kpage, &ste->zofs, &ste->zlen))
+		return false;
+	if(ste->slot != -1)
+	{
+		swap_slot_free(ste->slot);
+		ste->slot = -1;
+	}
+	vm_stat.zpageouts++;
+	return true;
+}
+
+/* Starts transferring the page recorded in STE to or from KPAGE
+   as a single multi-sector request R. The caller waits for R. */
+static void swap_submit_page(STE *ste, void *kpage, bool write, struct disk_request *r)
+{
+	disk_sector_t disk_sec;
+	struct disk *d;
+
+	ASSERT(ste->slot != -1);
+	d = swap_locate(ste->slot, &disk_sec);
+	disk_request_init(r, d, disk_sec, kpage, SWAP_STRIPE, write, NULL, NULL);
+	disk_submit(r);
 }
 
 unsigned swap_hash_hash_helper(const struct hash_elem * element, void * aux)
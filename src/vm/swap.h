@@ -1,5 +1,5 @@
-#ifndef VM_FRAME_H
-#define VM_FRAME_H
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
 
 #include <stdbool.h>
 #include <hash.h>
@@ -13,11 +13,19 @@
 #include "vm/frame.h"
 #include "vm/page.h"
 #include "devices/disk.h"
+#include "vm/zswap.h"
+#include <vmstat.h>
+
+struct frame_table_entry;
+struct page_table_entry;
 
 typedef struct swap_table_entry
 {
 	uint32_t *uaddr;              /* User virtual address of the swapped frame */
-	int sec_no[8];                /* Sector number that contains data */
+	int slot;                     /* Swap slot that contains data */
+	int zofs;                     /* first chunk in the zswap pool, or -1 */
+	int zlen;                     /* compressed length in the pool */
+	bool zero;                    /* all zeros, so stored nowhere */
 
 	struct hash_elem helem;       /* Hash element. */
 } STE;
@@ -26,16 +34,24 @@ typedef struct swap_table_entry
 
 struct semaphore swap_sema;       /* Swap table semaphore */
 
-struct bitmap *swapdisk_bitmap;   /* bitmap for managing swap disk */
-STE* parent_swap_set(uint32_t* upage, struct thread * parent);
+struct bitmap *swapdisk_bitmap;   /* bitmap of used swap slots */
 void swap_init(void);
-void swap_table_init(struct hash* h);
+void swap_add_disk(int chan_no, int dev_no);
+void swapdisk_bitmap_init(void);
+void swap_table_init(struct thread *t);
 STE* swap_set_ste(uint32_t *upage);
+STE* swap_thread_set(uint32_t* upage, struct thread * t);
 void swap_remove_ste(uint32_t* upage);
+void swap_clear_all(struct thread *t);
 STE* swap_ste_lookup(uint32_t *addr);
+STE* swap_thread_lookup(uint32_t *addr, struct thread *t);
 bool swap_in(uint32_t *uaddr);
-bool swap_out(uint32_t *uaddr);
-
-void swap_parent(uint32_t * uaddr);
+void swap_transit_wait(struct page_table_entry *pte);
+void swap_transit_begin(struct page_table_entry *pte);
+void swap_transit_end(struct page_table_entry *pte);
+bool swap_transit_wait_any(void);
+bool swap_out(struct frame_table_entry *fte);
+bool swap_clean(struct frame_table_entry *fte);
+void swap_vmstat(struct vmstat *st);
 
 #endif /* vm/swap.h */
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Compressed swap: a pool of kernel pages in front of the swap
+   disks. An evicted page is compressed with a small LZ77 coder
+   (the LZF format) and kept in the pool, so that swapping it in
+   again is a decompression instead of a disk read. Pages that do
+   not shrink to ZSWAP_MAX bytes, or that do not fit anymore, go
+   to disk as before.
+
+   The pool is a contiguous run of kernel pages, handed out in
+   ZSWAP_CHUNK byte chunks; a compressed page takes consecutive
+   chunks, possibly across page boundaries. */
+#define ZSWAP_CHUNK 64
+#define ZSWAP_MAX (PGSIZE * 3 / 4)
+
+size_t zswap_pages;                   /* -zswap=PAGES, 0 if disabled */
+
+static uint8_t *zswap_pool;           /* the pool, or NULL */
+static struct bitmap *zswap_map;      /* used chunks */
+static struct semaphore zswap_sema;   /* guards all of the above */
+static int zswap_stored;              /* pages in the pool */
+
+/* Compressor state, used under zswap_sema */
+#define LZ_HBITS 12
+#define LZ_MAX_OFF (1 << 13)
+#define LZ_MAX_LEN (7 + 255 + 2)
+static uint16_t lz_htab[1 << LZ_HBITS];
+static uint8_t lz_buf[PGSIZE];
+
+static size_t lz_compress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_max);
+static void lz_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len);
+
+/* Carves the pool out of the kernel pool. Does nothing unless
+   -zswap was given. */
+void zswap_init(void)
+{
+	sema_init(&zswap_sema, 1);
+	if(zswap_pages == 0)
+		return;
+
+	zswap_pool = palloc_get_multiple(0, zswap_pages);
+	zswap_map = bitmap_create(zswap_pages * PGSIZE / ZSWAP_CHUNK);
+	if(zswap_pool == NULL || zswap_map == NULL)
+	{
+		printf("zswap: cannot allocate %zu pages, disabled\n", zswap_pages);
+		if(zswap_pool != NULL)
+			palloc_free_multiple(zswap_pool, zswap_pages);
+		if(zswap_map != NULL)
+			bitmap_destroy(zswap_map);
+		zswap_pool = NULL;
+		zswap_pages = 0;
+	}
+}
+
+/* Compresses the page at KPAGE into the pool. On success stores
+   the first chunk into *ZOFS and the compressed length into
+   *ZLEN and returns true. Returns false if the pool is disabled
+   or full, or the page does not compress well enough. */
+bool zswap_store(const void *kpage, int *zofs, int *zlen)
+{
+	size_t len, chunk;
+
+	if(zswap_pool == NULL)
+		return false;
+
+	sema_down(&zswap_sema);
+	len = lz_compress(kpage, PGSIZE, lz_buf, ZSWAP_MAX);
+	chunk = len != 0
+		? bitmap_scan_and_flip(zswap_map, 0, DIV_ROUND_UP(len, ZSWAP_CHUNK), false)
+		: BITMAP_ERROR;
+	if(chunk != BITMAP_ERROR)
+	{
+		memcpy(zswap_pool + chunk * ZSWAP_CHUNK, lz_buf, len);
+		zswap_stored++;
+		*zofs = chunk;
+		*zlen = len;
+	}
+	sema_up(&zswap_sema);
+
+	return chunk != BITMAP_ERROR;
+}
+
+/* Decompresses the page stored at ZOFS, ZLEN into KPAGE. The
+   page stays in the pool. */
+void zswap_load(int zofs, int zlen, void *kpage)
+{
+	ASSERT(zswap_pool != NULL);
+	lz_decompress(zswap_pool + zofs * ZSWAP_CHUNK, zlen, kpage, PGSIZE);
+}
+
+/* Frees the pool space of the page stored at ZOFS, ZLEN. */
+void zswap_free(int zofs, int zlen)
+{
+	sema_down(&zswap_sema);
+	ASSERT(bitmap_all(zswap_map, zofs, DIV_ROUND_UP(zlen, ZSWAP_CHUNK)));
+	bitmap_set_multiple(zswap_map, zofs, DIV_ROUND_UP(zlen, ZSWAP_CHUNK), false);
+	zswap_stored--;
+	sema_up(&zswap_sema);
+}
+
+/* Fills in the pool part of ST. */
+void zswap_vmstat(struct vmstat *st)
+{
+	sema_down(&zswap_sema);
+	st->zpool_size = zswap_pages * PGSIZE;
+	st->zpool_used = zswap_map != NULL ? bitmap_count(zswap_map, 0, bitmap_size(zswap_map), true) * ZSWAP_CHUNK : 0;
+	st->zpool_pages = zswap_stored;
+	sema_up(&zswap_sema);
+}
+
+static unsigned lz_hash(const uint8_t *p)
+{
+	unsigned v = (p[0] << 16) | (p[1] << 8) | p[2];
+	return ((v * 2654435761u) >> (32 - LZ_HBITS)) & ((1 << LZ_HBITS) - 1);
+}
+
+/* Compresses IN_LEN bytes at IN into at most OUT_MAX bytes at
+   OUT. Returns the compressed length, or 0 if it would not fit.
+   The output is a sequence of literal runs (control byte 0..31:
+   that many bytes plus one follow) and back references (length
+   in the top 3 bits, extended by a byte if 7, and a 13 bit
+   offset). */
+static size_t lz_compress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_max)
+{
+	const uint8_t *ip = in, *in_end = in + in_len;
+	uint8_t *op = out, *out_end = out + out_max;
+	size_t lit = 0;
+
+	memset(lz_htab, 0, sizeof lz_htab);
+	op++;                       /* control byte of the first run */
+	while(ip < in_end)
+	{
+		if(ip + 2 < in_end)
+		{
+			unsigned h = lz_hash(ip);
+			const uint8_t *ref = in + lz_htab[h];
+			size_t off = ip - ref - 1;
+			lz_htab[h] = ip - in;
+
+			if(ref < ip && off < LZ_MAX_OFF
+				&& ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2])
+			{
+				size_t len = 3, max = in_end - ip;
+				if(max > LZ_MAX_LEN)
+					max = LZ_MAX_LEN;
+				while(len < max && ref[len] == ip[len])
+					len++;
+
+				/* close the literal run, or take back its unused
+				   control byte */
+				if(lit != 0)
+					op[-lit - 1] = lit - 1;
+				else
+					op--;
+				if(op + 4 > out_end)
+					return 0;
+
+				len -= 2;
+				if(len < 7)
+					*op++ = (off >> 8) + (len << 5);
+				else
+				{
+					*op++ = (off >> 8) + (7 << 5);
+					*op++ = len - 7;
+				}
+				*op++ = off;
+				op++;
+				lit = 0;
+				ip += len + 2;
+				continue;
+			}
+		}
+
+		if(op + 2 > out_end)
+			return 0;
+		*op++ = *ip++;
+		if(++lit == 32)
+		{
+			op[-lit - 1] = lit - 1;
+			lit = 0;
+			op++;
+		}
+	}
+
+	if(lit != 0)
+		op[-lit - 1] = lit - 1;
+	else
+		op--;
+	return op - out;
+}
+
+/* Decompresses IN_LEN bytes at IN, made by lz_compress(), into
+   OUT_LEN bytes at OUT. */
+static void lz_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len)
+{
+	const uint8_t *ip = in, *in_end = in + in_len;
+	uint8_t *op = out;
+
+	while(ip < in_end)
+	{
+		unsigned ctrl = *ip++;
+
+		if(ctrl < 32)
+		{
+			memcpy(op, ip, ctrl + 1);
+			op += ctrl + 1;
+			ip += ctrl + 1;
+		}
+		else
+		{
+			size_t len = ctrl >> 5;
+			const uint8_t *ref;
+
+			if(len == 7)
+				len += *ip++;
+			ref = op - ((ctrl & 0x1f) << 8) - *ip++ - 1;
+			/* may overlap with the output, so byte by byte */
+			for(len += 2; len > 0; len--)
+				*op++ = *ref++;
+		}
+	}
+	ASSERT(op == out + out_len);
+}
\ No newline at end of file
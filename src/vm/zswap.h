@@ -0,0 +1,16 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <vmstat.h>
+
+extern size_t zswap_pages;        /* -zswap: pages in the pool */
+
+void zswap_init(void);
+bool zswap_store(const void *kpage, int *zofs, int *zlen);
+void zswap_load(int zofs, int zlen, void *kpage);
+void zswap_free(int zofs, int zlen);
+void zswap_vmstat(struct vmstat *st);
+
+#endif /* vm/zswap.h */
\ No newline at end of file